@@ -0,0 +1,123 @@
+/*!
+ * @brief This file contains the implementation of an AsyncPlanner class.
+ *
+ * The AsyncPlanner class runs the player's search on a worker thread, so the
+ * game loop keeps drawing frames while a plan is being made. The worker has
+ * its own copy of the level, snake and player; each request carries a
+ * snapshot of the snake and the pellet, and the plan is handed back through
+ * an atomic flag, without the game loop ever waiting on a lock held during
+ * a search.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file async_planner.h
+ */
+
+#ifndef ASYNC_PLANNER_H
+#define ASYNC_PLANNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "level.h"
+#include "player.h"
+#include "snake.h"
+
+/**
+ * @class AsyncPlanner
+ * @brief Class that represents a player searching on a thread of its own.
+ *
+ * Every method must be called from the same thread, the game loop's.
+ */
+class AsyncPlanner
+{
+private:
+    Level level;                  //!< The worker's copy of the level.
+    Snake snake;                  //!< The worker's copy of the snake.
+    Player player;                //!< The worker's player.
+    std::mt19937 rng;             //!< Random engine of the worker's player.
+    bool astar = false;           //!< True to plan with A*, false with breadth first search.
+
+    std::thread worker;           //!< The thread that runs the searches.
+    std::mutex mutex;             //!< Guards the request and the flags below.
+    std::condition_variable wake; //!< Signals a new request or the shutdown.
+    bool has_request = false;     //!< True if a request is waiting for the worker.
+    bool stopping = false;        //!< True once the planner is being destroyed.
+    std::vector<TilePos> body;    //!< The snake's body in the request, from the head to the tail.
+    MoveDir dir;                  //!< The snake's direction in the request.
+    TilePos pellet;               //!< The pellet's position in the request.
+
+    std::atomic<bool> ready;      //!< Set by the worker once the plan of the last request is done.
+    bool pending = false;         //!< True from a request until its plan is collected.
+
+    /**
+     * @brief The loop of the worker: wait for a request, update the copies, search.
+     */
+    void work();
+
+public:
+    /**
+     * @brief Start the worker.
+     */
+    AsyncPlanner();
+
+    /**
+     * @brief Stop and join the worker, after the search it may be running.
+     */
+    ~AsyncPlanner();
+
+    AsyncPlanner(const AsyncPlanner &) = delete;
+    AsyncPlanner &operator=(const AsyncPlanner &) = delete;
+
+    /**
+     * @brief Select the search. Call it before the first request.
+     * @param use_astar True for A*, false for breadth first search.
+     * @param h The heuristic of A*.
+     * @param parallel_threshold Board cells from which breadth first search runs in parallel.
+     */
+    void configure(bool use_astar, heuristic_e h, size_t parallel_threshold);
+
+    /**
+     * @brief Copy the layout of a level, not its caches, for the next requests, with the snake at its spawn location.
+     *
+     * Call it when a level starts, after the snake is placed and before the
+     * pellet is, while no request is pending.
+     *
+     * @param l The level.
+     */
+    void load_level(const Level &l);
+
+    /**
+     * @brief Ask for a plan from a snapshot of the snake and the pellet.
+     * @param s The snake.
+     * @param pellet_loc The position of the pellet.
+     */
+    void request(const Snake &s, const TilePos pellet_loc);
+
+    /**
+     * @brief Check if a request is waiting for its plan to be collected.
+     * @return True from a request until poll returns true.
+     */
+    bool busy() const;
+
+    /**
+     * @brief Collect the plan of the last request, if it is done.
+     *
+     * Once it returns true the worker's player can be read, until the next request.
+     *
+     * @return True if the plan is done.
+     */
+    bool poll();
+
+    /**
+     * @brief Get the worker's player, e.g. for its solution and search counters.
+     * @return The player.
+     */
+    Player &get_player();
+};
+
+#endif
@@ -0,0 +1,86 @@
+/*!
+ * @brief This file contains the implementation of a BitBoard class.
+ *
+ * The BitBoard class keeps a set of cells of a board as row bitmasks, 64
+ * cells per word, so whole rows are combined with a few word operations.
+ * Its flood fill spreads along a word with shifts, ANDs and ORs and only
+ * revisits the words next to the ones that gained cells, so it touches each
+ * word a few times instead of each cell four times.
+ *
+ * Column c of a row is bit c % 64 of its word c / 64; the bits past the last
+ * column are always clear.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file bitboard.h
+ */
+
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class BitBoard
+ * @brief Class that represents a set of cells of a board, one bit per cell.
+ */
+class BitBoard
+{
+private:
+    size_t n_rows = 0;             //!< The number of rows.
+    size_t n_cols = 0;             //!< The number of columns.
+    size_t words = 0;              //!< The number of words of a row.
+    std::vector<uint64_t> bits;    //!< The rows, one after the other.
+    std::vector<uint32_t> work;    //!< Words the flood fill must look at again, reused between fills.
+    std::vector<uint8_t> queued;   //!< Marks the words in work.
+
+    /**
+     * @brief Queue the neighbours of a word that can take some of the cells it gained.
+     * @param open The cells the fill may enter.
+     * @param w The index of the word.
+     * @param gained The cells the word gained.
+     */
+    void wake(const BitBoard &open, const size_t w, const uint64_t gained);
+
+public:
+    /**
+     * @brief Set the size of the board and clear every cell.
+     * @param rows The number of rows.
+     * @param cols The number of columns.
+     */
+    void resize(const size_t rows, const size_t cols);
+
+    size_t rows() const { return n_rows; }
+    size_t cols() const { return n_cols; }
+    bool empty() const { return bits.empty(); }
+
+    void set(const size_t row, const size_t col) { bits[row * words + col / 64] |= uint64_t(1) << (col % 64); }
+    void reset(const size_t row, const size_t col) { bits[row * words + col / 64] &= ~(uint64_t(1) << (col % 64)); }
+    bool test(const size_t row, const size_t col) const { return bits[row * words + col / 64] >> (col % 64) & 1; }
+
+    /**
+     * @brief Count the cells in the set.
+     * @return The number of bits set.
+     */
+    size_t count() const;
+
+    /**
+     * @brief Make this set the cells of a that are not in b, a word at a time.
+     * @param a The first set.
+     * @param b The set taken away, of the same size as a.
+     */
+    void assign_and_not(const BitBoard &a, const BitBoard &b);
+
+    /**
+     * @brief Make this set the cells of open connected to a cell by steps up, down, left and right.
+     * @param open The cells the fill may enter.
+     * @param row The row of the cell the fill starts from.
+     * @param col The column of the cell the fill starts from.
+     * @return The number of cells filled, 0 if the start isn't in open.
+     */
+    size_t flood_fill(const BitBoard &open, const size_t row, const size_t col);
+};
+
+#endif
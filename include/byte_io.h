@@ -0,0 +1,53 @@
+/*!
+ * @brief This file contains the little-endian integer helpers of the binary files.
+ *
+ * Precompiled levels, replay logs and plan caches all store their integers
+ * little-endian, whatever the byte order of the machine.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file byte_io.h
+ */
+
+#ifndef BYTE_IO_H
+#define BYTE_IO_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Append a 32-bit integer to a buffer, little-endian.
+ */
+inline void put_u32(std::string &out, const uint32_t v)
+{
+    for (int i{0}; i < 4; ++i) out += static_cast<char>(v >> (8 * i) & 0xff);
+}
+
+/**
+ * @brief Append a 64-bit integer to a buffer, little-endian.
+ */
+inline void put_u64(std::string &out, const uint64_t v)
+{
+    put_u32(out, static_cast<uint32_t>(v));
+    put_u32(out, static_cast<uint32_t>(v >> 32));
+}
+
+/**
+ * @brief Read a little-endian 32-bit integer.
+ * @param p The first of its 4 bytes.
+ */
+inline uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+/**
+ * @brief Read a little-endian 64-bit integer.
+ * @param p The first of its 8 bytes.
+ */
+inline uint64_t get_u64(const uint8_t *p)
+{
+    return get_u32(p) | static_cast<uint64_t>(get_u32(p + 4)) << 32;
+}
+
+#endif
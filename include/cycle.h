@@ -0,0 +1,113 @@
+/*!
+ * @brief This file contains the implementation of a HamiltonianCycle class.
+ *
+ * The HamiltonianCycle class holds a closed tour that visits every cell the
+ * snake can reach from the spawn location exactly once. A snake that follows
+ * it never runs into itself, and since the tour is stored as a successor and
+ * a position for each cell, every decision about it takes constant time.
+ *
+ * Two constructions are tried when the level starts: a back and forth sweep
+ * when the reachable cells form a rectangle with an even side, and a walk
+ * around a spanning tree of 2x2 blocks when they can be tiled by such blocks.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file cycle.h
+ */
+
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "level.h"
+
+/**
+ * @class HamiltonianCycle
+ * @brief Class that represents a Hamiltonian cycle over the reachable cells of a level.
+ */
+class HamiltonianCycle
+{
+private:
+    std::vector<uint32_t> next;  //!< The cell after each cell along the cycle, or NO_CELL if it's not on it.
+    std::vector<uint32_t> order; //!< The position of each cell along the cycle.
+    size_t length = 0;           //!< The number of cells of the cycle, 0 if there is none.
+    size_t stride = 0;           //!< The stride of the grid of the level.
+
+    /**
+     * @brief Sweep a full rectangle back and forth, coming back along its first column (or row).
+     * @param level The level.
+     * @param top_left The top left cell of the rectangle.
+     * @param rows The number of rows of the rectangle.
+     * @param cols The number of columns of the rectangle.
+     * @return True if the rectangle has an even side and at least two cells on each side.
+     */
+    bool build_sweep(Level &level, const TilePos top_left, const size_t rows, const size_t cols);
+
+    /**
+     * @brief Tile the cells with 2x2 blocks and walk around a spanning tree of the blocks.
+     * @param level The level.
+     * @param in_component Marks the reachable cells, indexed like the grid.
+     * @return True if some alignment of the blocks covers exactly the reachable cells.
+     */
+    bool build_blocks(Level &level, const std::vector<uint8_t> &in_component);
+
+    /**
+     * @brief Number the cells along the cycle, starting at a cell.
+     * @param start The index of the first cell in the grid.
+     * @param n The number of cells the cycle should have.
+     * @return True if the walk came back to the start after visiting n cells.
+     */
+    bool number_cells(const uint32_t start, const size_t n);
+
+public:
+    static const uint32_t NO_CELL = UINT32_MAX; //!< Marks a cell that is not on the cycle.
+
+    /**
+     * @brief Build a cycle through every cell reachable from the spawn location.
+     * @param level The level, with no snake or pellet placed yet.
+     * @return True if a cycle was found; otherwise the cycle is left empty.
+     */
+    bool build(Level &level);
+
+    /**
+     * @brief Check if there is no cycle.
+     * @return True if the last build failed.
+     */
+    bool empty() const { return length == 0; }
+
+    /**
+     * @brief Get the number of cells of the cycle.
+     * @return The number of cells.
+     */
+    size_t size() const { return length; }
+
+    /**
+     * @brief Get the cell after a cell along the cycle.
+     * @param cell The index of the cell in the grid.
+     * @return The index of the next cell, or NO_CELL.
+     */
+    uint32_t next_cell(const uint32_t cell) const { return next[cell]; }
+
+    /**
+     * @brief Get how many steps along the cycle take from one cell to another.
+     * @param from The index of the first cell in the grid.
+     * @param to The index of the second cell in the grid.
+     * @return The number of steps, in [0, size()).
+     */
+    size_t distance(const uint32_t from, const uint32_t to) const
+    {
+        return order[to] >= order[from] ? order[to] - order[from] : order[to] + length - order[from];
+    }
+
+    /**
+     * @brief Check if a cell is on the cycle.
+     * @param cell The index of the cell in the grid.
+     * @return True if the cell is on the cycle.
+     */
+    bool contains(const uint32_t cell) const { return cell < next.size() && next[cell] != NO_CELL; }
+};
+
+#endif
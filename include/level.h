@@ -2,14 +2,16 @@
  * @brief This file contains the implementation of a Level class.
  *
  * The Level class is responsible for storing the game level, which is
- * represented by a vector of strings. Each character represent the
- * following:
+ * represented by a flat grid of tile types surrounded by a one-cell border
+ * of walls, so a neighbor lookup never needs a bounds check. Walls never
+ * move, so the level also caches breadth first distance fields around them.
+ * For reachability it keeps the walls and the snake as row bitmasks too.
+ * In the level files each character represent the following:
  *
  * - '#' : wall
  * - ' ' : empty space
- * - '@' : snake head
- * - '*' : snake body
- * - 'o' : food
+ * - '.' : invisible wall
+ * - '*' : snake spawn location
  *
  * @author Tobias dos Santos Neto e Wisla Alves Argolo
  * @date July 16st, 2023.
@@ -22,6 +24,10 @@
 #include <vector>
 #include <string>
 #include <random>
+#include <cstdint>
+#include <unordered_map>
+
+#include "bitboard.h"
 
 /**
  * @brief Struct that represents a tile position.
@@ -80,6 +86,16 @@ enum tile_type_e
     SNAKEBODY
 };
 
+/**
+ * @brief Struct that represents a cached distance field.
+ */
+struct DistanceField
+{
+    uint32_t goal;              //!< The cell the distances are measured to, as a grid index.
+    uint64_t last_used;         //!< When the field was last requested, for the LRU eviction.
+    std::vector<uint32_t> dist; //!< The distance of each cell to the goal, or UINT32_MAX if unreachable.
+};
+
 /**
  * @class Level
  * @brief Class that represents a level of the game.
@@ -87,15 +103,65 @@ enum tile_type_e
 class Level
 {
 private:
-    std::vector<std::string> board; //!< The board of the level.
-    TilePos snake_spawn_loc;        //!< The spawn location of the snake.
-    TilePos pellet_loc;             //!< The location of the pellet.
-    int n_cols;                     //!< The number of columns of the level.
-    int n_rows;                     //!< The number of rows of the level.
+    std::vector<uint8_t> grid; //!< The tile types, row by row, with a border of walls.
+    TilePos snake_spawn_loc;   //!< The spawn location of the snake.
+    TilePos pellet_loc{0, 0};  //!< The location of the pellet.
+    int n_cols;                //!< The number of columns of the level.
+    int n_rows;                //!< The number of rows of the level.
+    size_t stride;             //!< The distance between two rows of the grid, n_cols + 2.
+    size_t loaded_rows = 0;    //!< The number of rows added by add_line.
+    size_t n_walkable = 0;     //!< The number of cells that are not walls or invisible walls.
+    bool has_spawn = false;    //!< True once a row with a spawn location was added.
+
+    std::vector<uint32_t> free_cells; //!< The empty cells, as grid indexes, in no particular order.
+    std::vector<uint32_t> free_slot;  //!< The index of each cell in free_cells, or NOT_FREE.
+
+    static const uint32_t NOT_FREE = UINT32_MAX; //!< Marks a cell that is not in free_cells.
+
+    std::vector<DistanceField> fields;                   //!< The cached distance fields.
+    std::unordered_map<uint32_t, uint32_t> field_slot;   //!< The index in fields of the field of each goal.
+    std::vector<uint32_t> field_queue;                   //!< Queue of the breadth first search, reused between fields.
+    uint64_t field_clock = 0;                            //!< Counts the requests of distance fields.
+    BitBoard spawn_reach;                                //!< The cells reachable from the spawn location, once computed.
+    BitBoard open_bits;                                  //!< The cells that are not walls or invisible walls, once computed.
+    BitBoard snake_bits;                                 //!< The cells taken by the snake, kept up to date once open_bits is built.
+    BitBoard region_open;                                //!< The cells region_size may enter, reused between calls.
+    BitBoard region;                                     //!< The cells filled by region_size, reused between calls.
+
+    static const size_t FIELD_CACHE_BYTES = 32u << 20;  //!< Memory the cached distance fields may take.
+    static const int MAX_PELLET_DRAWS = 16;             //!< Random draws before place_pellet lists the reachable cells.
+
+    /**
+     * @brief Fill a distance field with a breadth first search from its goal around the walls.
+     * @param field The field, with its goal set.
+     */
+    void compute_field(DistanceField &field);
+
+    /**
+     * @brief Build open_bits and snake_bits from the grid.
+     */
+    void build_bits();
+
+    /**
+     * @brief Fill spawn_reach with the cells reachable from the spawn location.
+     */
+    void compute_reach();
 
-    std::string tile_type = " #.@*o"; //!< The string that represents the tile types.
+    /**
+     * @brief Adds a cell to the free-cell index.
+     * @param cell The index of the cell in the grid.
+     */
+    void add_free(const uint32_t cell);
+
+    /**
+     * @brief Removes a cell from the free-cell index by swapping it with the last one.
+     * @param cell The index of the cell in the grid.
+     */
+    void remove_free(const uint32_t cell);
 
 public:
+    static const size_t MAX_SIZE = 4096; //!< Largest number of rows or columns of a level.
+
     /**
      * @brief Sets the number of columns and rows of the level.
      * @param cols The number of columns of the level.
@@ -118,19 +184,25 @@ public:
      * @brief Get the columns amount of the level.
      * @return The columns amount of the level.
      */
-    size_t get_cols();
+    size_t get_cols() const;
 
     /**
      * @brief Get the rows amount of the level.
      * @return The rows amount of the level.
      */
-    size_t get_rows();
+    size_t get_rows() const;
+
+    /**
+     * @brief Get the number of cells the snake can walk on.
+     * @return The number of cells that are not walls or invisible walls.
+     */
+    size_t get_walkable() const;
 
     /**
      * @brief Get the spawn location of the snake.
      * @return The spawn location of the snake.
      */
-    TilePos get_spawn();
+    TilePos get_spawn() const;
 
     /**
      * @brief Get the location of the pellet.
@@ -139,11 +211,147 @@ public:
     TilePos get_pellet_loc();
 
     /**
-     * @brief Add a line to the level.
-     * @param line The line to be added.
+     * @brief Add a line to the level. The rows and columns must be set before.
+     * @param line The line to be added; missing columns are empty spaces.
      */
     void add_line(std::string line);
 
+    /**
+     * @brief Add a row straight from the bytes of a level file.
+     *
+     * In a single pass the bytes are validated, translated into tile types and
+     * searched for the spawn location ('*'). The first '*' of the row becomes the
+     * spawn location, replacing any found in earlier rows. Unknown symbols are
+     * stored as empty spaces, bytes past the number of columns are only validated
+     * and missing columns are empty spaces.
+     *
+     * @param data The bytes of the row, without the line break.
+     * @param len The number of bytes.
+     * @return The index of the first byte that isn't a level symbol, or len if there is none.
+     */
+    size_t add_row(const char *data, const size_t len);
+
+    /**
+     * @brief Load the whole level from its precompiled form, with no per-tile processing.
+     *
+     * The rows, columns and spawn location must be set before.
+     *
+     * @param cells The grid, border included, as written by get_grid.
+     * @param free The empty cells, as grid indexes, as written by get_free_cells.
+     * @param n_free The number of empty cells.
+     * @param walkable The number of cells that are not walls or invisible walls.
+     */
+    void load_packed(const uint8_t *cells, const uint32_t *free, const size_t n_free, const size_t walkable);
+
+    /**
+     * @brief Take the grid, free-cell index, spawn and pellet locations of another level.
+     *
+     * Unlike a copy of the whole level, the other level's cached distance fields
+     * and bitmasks are left behind, and this level's are dropped: they are
+     * rebuilt as they are needed.
+     *
+     * @param l The level.
+     */
+    void copy_layout(const Level &l);
+
+    /**
+     * @brief Get the grid of the level, border included.
+     * @return The tile types, row by row.
+     */
+    const std::vector<uint8_t> &get_grid() const { return grid; }
+
+    /**
+     * @brief Get the index of the empty cells, in the order place_pellet draws from.
+     * @return The empty cells, as grid indexes.
+     */
+    const std::vector<uint32_t> &get_free_cells() const { return free_cells; }
+
+    /**
+     * @brief Check if a spawn location was found in the rows added so far.
+     * @return True if the level has a spawn location.
+     */
+    bool get_has_spawn();
+
+    /**
+     * @brief Get the distance between two rows of the grid.
+     * @return The number of columns plus the two border cells.
+     */
+    size_t get_stride() const { return stride; }
+
+    /**
+     * @brief Get the number of cells of the grid, border included.
+     * @return The size of the grid.
+     */
+    size_t get_cells() const { return grid.size(); }
+
+    /**
+     * @brief Get the index in the grid of a position.
+     *
+     * Positions one step outside the board, including row or column -1
+     * wrapped around as size_t, fall on the border of walls.
+     *
+     * @param pos The position.
+     * @return The index of the cell in the grid.
+     */
+    size_t cell_index(const TilePos pos) const { return (pos.row + 1) * stride + (pos.col + 1); }
+
+    /**
+     * @brief Get the position of a cell of the grid.
+     * @param cell The index of the cell, which must not be on the border.
+     * @return The position of the cell.
+     */
+    TilePos cell_pos(const size_t cell) const { return {cell / stride - 1, cell % stride - 1}; }
+
+    /**
+     * @brief Get the tile type of a cell of the grid.
+     * @param cell The index of the cell.
+     * @return The tile type of the cell.
+     */
+    tile_type_e tile_at(const size_t cell) const { return static_cast<tile_type_e>(grid[cell]); }
+
+    /**
+     * @brief Get the distance of every cell to a goal, walking around the walls only.
+     *
+     * The snake is ignored, so the distances are lower bounds of the moves it
+     * needs. Fields are computed the first time a goal is requested and kept in
+     * a cache of at most FIELD_CACHE_BYTES (but always at least one field),
+     * evicting the least recently used one.
+     *
+     * @param goal The index of the goal cell in the grid.
+     * @return The distance of each cell, indexed like the grid, or UINT32_MAX if
+     * the goal can't be reached. Valid until the next call.
+     */
+    const uint32_t *distance_field(const uint32_t goal);
+
+    /**
+     * @brief Check if a cell can be reached from the spawn location, walking around the walls.
+     *
+     * Kept apart from the distance fields, at one bit per cell, so it stays
+     * cached on boards where a single field fills the whole cache. The snake
+     * never leaves this region, so a cell out of it can't be reached from
+     * the head either.
+     *
+     * @param cell The index of the cell in the grid.
+     * @return True if the cell can be reached.
+     */
+    bool reachable(const uint32_t cell)
+    {
+        if (spawn_reach.empty()) compute_reach();
+        size_t row = cell / stride, col = cell % stride;
+        return row >= 1 && col >= 1 && row <= size_t(n_rows) && col <= size_t(n_cols) && spawn_reach.test(row - 1, col - 1);
+    }
+
+    /**
+     * @brief Count the cells reachable from a position without crossing a wall or the snake.
+     *
+     * Runs a flood fill over the row bitmasks, so it is cheap enough to call
+     * every tick, e.g. to tell how much room the snake's head has.
+     *
+     * @param from The position, which may be the snake's head.
+     * @return The number of cells, from included, or 0 if from is a wall.
+     */
+    size_t region_size(const TilePos from);
+
     /**
      * @brief Get the empty spaces of the level.
      * @return The empty spaces of the level.
@@ -162,12 +370,28 @@ public:
      * @param pos The position to be checked.
      * @return The tile type at the given position.
      */
-    tile_type_e get_tile_type(const TilePos pos);
+    tile_type_e get_tile_type(const TilePos pos) const { return tile_at(cell_index(pos)); }
+
+    /**
+     * @brief Places a food pellet in a random empty space other than the spawn location.
+     *
+     * The empty spaces are kept in an index updated by set_tile_type, so this
+     * usually takes a single random draw. Cells walled off from the spawn
+     * location are drawn again; after MAX_PELLET_DRAWS misses the pellet goes
+     * to a uniform pick among the reachable cells. Nothing is placed if there
+     * is no candidate.
+     *
+     * @param gen The random engine of the simulation.
+     * @return True if a pellet was placed.
+     */
+    bool place_pellet(std::mt19937 &gen);
 
     /**
-     * @brief Places a food pellet in a random empty space.
+     * @brief Places a food pellet at a given position, e.g. one read from a replay.
+     * @param pos The position of the pellet.
+     * @return True if the position was inside the level and empty.
      */
-    void place_pellet();
+    bool place_pellet_at(const TilePos pos);
 
     /**
      * @brief Checks if the tile at the given position is a wall, an invisible wall or the snake body.
@@ -0,0 +1,53 @@
+/*!
+ * @brief This file contains the level file loader.
+ *
+ * The level file is mapped into memory and parsed in a single pass: each
+ * row is validated and written straight into the grid of its level, with
+ * no intermediate line strings. Errors report the line and column where
+ * the file stopped making sense.
+ *
+ * Level packs can also be precompiled (see snaze-compile) into a binary
+ * format, detected by its magic number, which loads with a few copies per
+ * level. All integers are 32-bit little-endian:
+ *
+ * - "SNZB", version, number of levels
+ * - per level: rows, columns, spawn row, spawn column, walkable cells,
+ *   empty cells; the grid with its border of walls, one tile_type_e per
+ *   byte; the empty cells as grid indexes, in the order the text loader
+ *   finds them, so a game plays the same from either format.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file level_loader.h
+ */
+
+#ifndef LEVEL_LOADER_H
+#define LEVEL_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "level.h"
+
+/**
+ * @brief Load the levels of a level file, either text or precompiled.
+ *
+ * In a text file each level starts with a line holding its number of rows and columns, both
+ * in [1,Level::MAX_SIZE], followed by its rows. Blank lines between levels are skipped and
+ * levels without a spawn location are dropped.
+ *
+ * @param path The path of the level file.
+ * @param levels The vector the levels are appended to.
+ * @throw std::runtime_error If the file can't be read or is malformed.
+ */
+void load_levels(const std::string &path, std::vector<Level> &levels);
+
+/**
+ * @brief Write levels in the precompiled binary format.
+ * @param path The path of the file to be written.
+ * @param levels The levels, as loaded from a level file.
+ * @throw std::runtime_error If the file can't be written.
+ */
+void save_levels(const std::string &path, const std::vector<Level> &levels);
+
+#endif
@@ -0,0 +1,31 @@
+/*!
+ * @brief This file contains the procedural maze generator.
+ *
+ * Mazes are carved with a randomized depth first search over a lattice of
+ * rooms (the cells with even row and column), then a few walls between rooms
+ * are knocked down so the maze has loops as well as dead ends. They are meant
+ * for stress tests on boards far larger than anyone would write by hand.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file maze.h
+ */
+
+#ifndef MAZE_H
+#define MAZE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "level.h"
+
+/**
+ * @brief Generate a maze level, with the spawn location at the top left corner.
+ * @param rows The number of rows, in [1, Level::MAX_SIZE].
+ * @param cols The number of columns, in [1, Level::MAX_SIZE].
+ * @param seed The seed; the same seed and size make the same maze.
+ * @return The level.
+ */
+Level generate_maze(const size_t rows, const size_t cols, const uint64_t seed);
+
+#endif
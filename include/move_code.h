@@ -0,0 +1,36 @@
+/*!
+ * @brief This file contains the 2-bit codes of the snake's moves.
+ *
+ * The code of a move is its index in the order the player expands the
+ * moves of a search node. The same codes are written to replay logs and
+ * plan caches, so changing the order changes both file formats.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file move_code.h
+ */
+
+#ifndef MOVE_CODE_H
+#define MOVE_CODE_H
+
+#include "snake.h"
+
+//! The moves in the order of their 2-bit codes.
+const MoveDir MOVE_CODES[4] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
+
+//! The code of the neutral direction, which has no 2-bit code.
+const unsigned NEUTRAL_CODE = 4;
+
+/**
+ * @brief Get the code of a direction.
+ * @param dir The direction.
+ * @return The code, 0 to 3, or NEUTRAL_CODE for any other direction.
+ */
+inline unsigned move_code(const MoveDir dir)
+{
+    unsigned code = 0;
+    while (code < 4 && !(MOVE_CODES[code] == dir)) ++code;
+    return code;
+}
+
+#endif
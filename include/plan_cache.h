@@ -0,0 +1,140 @@
+/*!
+ * @brief This file contains the implementation of a PlanCache class.
+ *
+ * The PlanCache class keeps the plans of the last searches, keyed by the
+ * Zobrist key of the state they were made from, so a state seen before
+ * (e.g. the snake at its spawn location after a crash, with the pellet
+ * where it was) is answered without searching again. The cache can be
+ * saved to a file and loaded on the next run.
+ *
+ * All integers of the file are little-endian:
+ *
+ * - "SNZP", version, number of entries;
+ * - then the entries, from the least to the most recently used: hash of the
+ *   level, planner, direction code, row and column of the pellet, number of
+ *   body cells, row and column of each cell from the head, number of moves,
+ *   then 4 moves per byte, lowest bits first.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file plan_cache.h
+ */
+
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "level.h"
+#include "snake.h"
+#include "zobrist.h"
+
+/**
+ * @brief Enum that represents the search a plan was made with.
+ */
+enum plan_kind_e
+{
+    PLAN_BFS,            //!< Breadth first search.
+    PLAN_ASTAR_DISTANCE, //!< A* with the distance field heuristic.
+    PLAN_ASTAR_MANHATTAN //!< A* with the Manhattan heuristic.
+};
+
+/**
+ * @brief Struct that represents everything a search depends on.
+ */
+struct PlanState
+{
+    uint64_t key = 0;            //!< Zobrist key of the state, see plan_key.
+    uint64_t level = 0;          //!< Hash of the level as loaded, see hash_level.
+    uint8_t planner = PLAN_BFS;  //!< The search, a plan_kind_e.
+    uint8_t dir = 4;             //!< Move code of the snake's direction, 4 for the neutral direction.
+    TilePos pellet;              //!< The pellet's position.
+    std::vector<TilePos> body;   //!< The snake's body, from the head to the tail.
+};
+
+/**
+ * @brief Combine the keys of a state into its Zobrist key.
+ * @param level Hash of the level.
+ * @param planner The search.
+ * @param dir Move code of the snake's direction.
+ * @param pellet The pellet's position.
+ * @param head The snake's head.
+ * @param body_key Xor of the zobrist_key of every body cell, head included.
+ * @return The key.
+ */
+inline uint64_t plan_key(const uint64_t level, const uint8_t planner, const uint8_t dir, const TilePos pellet,
+                         const TilePos head, const uint64_t body_key)
+{
+    return splitmix64(level ^ planner) ^ zobrist_dir_key(dir) ^ zobrist_key(pellet, ZOBRIST_PELLET) ^
+           zobrist_key(head, ZOBRIST_HEAD) ^ body_key;
+}
+
+/**
+ * @class PlanCache
+ * @brief Class that represents a bounded cache of plans, dropping the least recently used.
+ */
+class PlanCache
+{
+private:
+    /**
+     * @brief Struct that represents a cached plan.
+     */
+    struct Entry
+    {
+        PlanState state;             //!< The state the plan was made from, to tell apart keys that collide.
+        std::vector<uint8_t> moves;  //!< The moves, 2 bits each.
+        uint32_t n_moves;            //!< The number of moves.
+    };
+
+    std::list<Entry> entries;        //!< The entries, the most recently used first.
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index; //!< The entries by key.
+    size_t capacity = 0;             //!< The most entries kept, 0 to cache nothing.
+
+public:
+    static const size_t MAX_BODY = 256;     //!< Longest snake whose plans are cached.
+    static const size_t MAX_MOVES = 65536;  //!< Longest plan that is cached.
+
+    /**
+     * @brief Select the most entries kept, dropping the least recently used ones over it.
+     * @param n The number of entries, 0 to cache nothing.
+     */
+    void set_capacity(const size_t n);
+
+    size_t size() const { return entries.size(); }
+
+    /**
+     * @brief Find the plan of a state, marking it as the most recently used.
+     * @param state The state, with its key.
+     * @param moves The plan, if found.
+     * @return True if the state is in the cache.
+     */
+    bool lookup(const PlanState &state, std::vector<MoveDir> &moves);
+
+    /**
+     * @brief Add the plan of a state, unless the snake or the plan is too long.
+     * @param state The state, with its key.
+     * @param moves The plan, empty if the search found no path.
+     */
+    void insert(const PlanState &state, const std::vector<MoveDir> &moves);
+
+    /**
+     * @brief Add the entries of a cache file. A missing file adds nothing.
+     *
+     * @throw std::runtime_error if the file isn't a plan cache or is truncated.
+     * @param path The path of the file.
+     */
+    void load(const std::string &path);
+
+    /**
+     * @brief Write the entries to a cache file.
+     * @param path The path of the file.
+     * @return False if the file couldn't be written.
+     */
+    bool save(const std::string &path) const;
+};
+
+#endif
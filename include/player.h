@@ -2,8 +2,10 @@
  * @brief This file contains the implementation of a Player class.
  *
  * The Player class is responsible for manage the snake's movements. It has a
- * pointer to the snake and to the level it is currently in. There are two possible
- * ways to move the snake: randomly or using a backtracking algorithm.
+ * pointer to the snake and to the level it is currently in. There are four possible
+ * ways to move the snake: randomly, using a backtracking algorithm (breadth first
+ * search), using an A* search guided by a pluggable heuristic or following a
+ * Hamiltonian cycle of the level.
  *
  * @author Tobias dos Santos Neto e Wisla Alves Argolo
  * @date July 16st, 2023.
@@ -15,6 +17,46 @@
 
 #include "snake.h"
 #include "level.h"
+#include "visited_table.h"
+#include "cycle.h"
+#include "worker_pool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @brief Struct that represents a node of the search tree.
+ *
+ * Nodes live in an arena owned by the Player. Instead of carrying the path and
+ * the snake's body, each node only knows its parent and the move that led to it;
+ * both are rebuilt by walking back through the ancestors.
+ */
+struct SearchNode
+{
+  uint32_t parent_move; //<! Index of the parent node shifted left by 2, or'ed with the 2-bit move.
+  uint32_t cell;        //<! The position of the snake's head, as an index in the level grid.
+  uint32_t depth;       //<! Number of moves from the root to the node.
+};
+
+/**
+ * @brief Enum that represents the heuristics available to the A* planner.
+ */
+enum heuristic_e
+{
+  MANHATTAN = 0, //<! Manhattan distance to the pellet, ignoring walls.
+  DISTANCE       //<! Breadth first distance to the pellet around the walls, cached by the level.
+};
+
+/**
+ * @brief Struct that represents an entry of the A* open list.
+ */
+struct OpenEntry
+{
+  uint32_t f;    //<! Estimated length of a path through the node.
+  uint32_t g;    //<! Length of the path from the root to the node.
+  uint32_t node; //<! Index of the node in the arena.
+};
 
 /**
  * @class Player
@@ -25,8 +67,34 @@ class Player
 private:
   Snake *snake;                             //<! Pointer to the snake.
   Level *running_level;                     //<! Pointer to the level the player is currently in.
+  std::mt19937 *rng;                        //<! Pointer to the random engine of the simulation.
   std::vector<MoveDir> solution;            //<! Vector of MoveDir that represents the solution to the level.
   std::vector<MoveDir>::iterator curr_move; //<! Iterator to the current move.
+  VisitedTable visited;                     //<! Closed set of the search, reused between calls.
+  std::vector<SearchNode> nodes;            //<! Arena with the nodes of the search, reused between calls.
+  std::vector<uint32_t> initial_body;       //<! Cells of the snake's body when the search started.
+  std::vector<uint32_t> free_at;            //<! Depth at which each cell of the initial body is left behind.
+  long move_offset[4];                      //<! Grid offset of each move, indexed by its 2-bit code.
+  std::vector<OpenEntry> open;              //<! Binary heap with the A* open list, reused between calls.
+  const uint32_t *goal_distance = nullptr;  //<! Distance from each cell to the pellet around the walls, cached by the level.
+  heuristic_e heuristic = DISTANCE;         //<! Heuristic used by the A* planner.
+  size_t nodes_expanded = 0;                //<! Number of nodes expanded by the last search.
+  size_t peak_frontier = 0;                 //<! Largest size of the queue or open list in the last search.
+  HamiltonianCycle cycle;                   //<! Cycle through the reachable cells of the level, if it has one.
+
+  size_t parallel_threshold = 0;            //<! Board cells from which find_solution searches in parallel, 0 for never.
+  bool searched_in_parallel = false;        //<! True if the last search ran in parallel.
+  std::unique_ptr<WorkerPool> pool;         //<! Threads of the parallel search, started on its first use.
+  ConcurrentVisitedTable shared_visited;    //<! Closed set of the parallel search.
+  std::unique_ptr<std::atomic<uint32_t>[]> cell_head; //<! Last node of the current layer seen on each cell, or no_node.
+  size_t n_cell_head = 0;                   //<! Number of cells in cell_head.
+  std::vector<uint32_t> layer_link;         //<! For each node of the layer, the previous one seen on its cell.
+  std::vector<uint8_t> layer_moves;         //<! For each node of the layer, the moves that pass every check but duplicates.
+  std::vector<uint8_t> layer_keep;          //<! For each node of the layer, the moves no earlier node on its cell took.
+  std::vector<uint32_t> chunk_goal;         //<! First node on the pellet found by each chunk of the layer.
+  std::vector<size_t> chunk_children;       //<! Children added before each chunk of the layer.
+
+  static const uint32_t MIN_PARALLEL_LAYER = 1024; //<! Smaller layers are expanded by the calling thread alone.
 
   /**
    * @brief Get a random number between min and max.
@@ -44,24 +112,178 @@ private:
    */
   bool is_valid(MoveDir dir, MoveDir curr);
 
+  /**
+   * @brief Pack a search state into a single integer key.
+   * @param cell The cell of the snake's head.
+   * @param dir_idx The 2-bit index of the direction the snake is facing.
+   * @return The key in [0, cells * 4).
+   */
+  size_t state_key(uint32_t cell, unsigned dir_idx);
+
+  /**
+   * @brief Check if a cell is a wall or an invisible wall.
+   * @param cell The index of the cell in the level grid.
+   * @return True if the snake can never enter the cell.
+   */
+  bool blocked(uint32_t cell);
+
+  /**
+   * @brief Check if a cell is taken by the snake's body in the state of a node.
+   *
+   * The body the snake had when the search started is checked in O(1) with the
+   * free_at grid. Only the part of the body laid down by the path itself is
+   * checked by walking back through the ancestors.
+   *
+   * @param node Index of the node in the arena.
+   * @param cell The cell to be checked.
+   * @return True if the cell is part of the body, not counting the tail.
+   */
+  bool hits_body(uint32_t node, uint32_t cell);
+
+  /**
+   * @brief Reset the arena and push the root node with the snake's current state.
+   *
+   * Also fetches the level's distance field of the pellet into goal_distance, or
+   * null if the pellet is walled off from the spawn location, and so from the snake.
+   *
+   * @return True if the snake is facing the neutral direction.
+   */
+  bool start_search();
+
+  /**
+   * @brief Try to plan by walking down the pellet's distance field, without searching.
+   *
+   * From each cell the first move, in expansion order, that gets one step closer
+   * to the pellet around the walls is taken. If none of those moves runs into
+   * the body, the path has the length of the lower bound, so it is a shortest
+   * path, and it's the one breadth first search and A* with the DISTANCE
+   * heuristic find first.
+   *
+   * @return True if the path reached the pellet and the solution was built.
+   */
+  bool follow_distance_field();
+
+  /**
+   * @brief Run the breadth first search one layer at a time, splitting each layer across the worker pool.
+   *
+   * A child state is kept only if no node before its parent in the queue took
+   * it. Competing parents always sit on the same cell, so each layer links its
+   * nodes by cell and a node only checks the few others on its own cell. The
+   * nodes are added to the arena in the order the serial search adds them,
+   * so both find the same solution and expand as many nodes.
+   *
+   * @param neutral True if the snake is facing the neutral direction.
+   */
+  void find_solution_parallel(bool neutral);
+
+  /**
+   * @brief Rebuild the solution by walking back from a node to the root.
+   * @param goal Index of the node that reached the pellet.
+   */
+  void build_solution(uint32_t goal);
+
+  /**
+   * @brief Estimate the number of moves from a cell to the pellet.
+   * @param cell The index of the cell in the level grid.
+   * @return A lower bound of the distance, or UINT32_MAX if the pellet can't be reached.
+   */
+  uint32_t estimate(uint32_t cell);
+
 public:
   /**
-   * @brief Get the solution to the level.
-   * @return A vector of MoveDir.
+   * @brief Get the solution to the level, without copying it.
+   * @return A vector of MoveDir, valid until the next search or set_solution.
+   */
+  const std::vector<MoveDir> &get_solution() const;
+
+  /**
+   * @brief Replace the solution, e.g. with one planned by another player.
+   * @param moves The moves from the snake's current state to the pellet.
    */
-  std::vector<MoveDir> get_solution();
+  void set_solution(const std::vector<MoveDir> &moves);
 
   /**
    * @brief Find a solution to the level using the backtracking strategy with breadth first search.
+   *
+   * On boards past the parallel threshold the search is split across threads,
+   * with the same result.
    */
   void find_solution();
 
+  /**
+   * @brief Find a solution to the level using A* with the selected heuristic.
+   */
+  void find_solution_astar();
+
+  /**
+   * @brief Select the heuristic used by the A* planner.
+   * @param h The heuristic.
+   */
+  void set_heuristic(heuristic_e h);
+
+  /**
+   * @brief Get the number of nodes expanded by the last search.
+   * @return The number of nodes expanded.
+   */
+  size_t get_nodes_expanded();
+
+  /**
+   * @brief Get the largest size the BFS queue or the A* open list reached in the last search.
+   * @return The peak frontier size.
+   */
+  size_t get_peak_frontier();
+
+  /**
+   * @brief Get the number of states marked as visited by the last search.
+   * @return The size of the closed set.
+   */
+  size_t get_visited();
+
+  /**
+   * @brief Select the board size from which find_solution runs in parallel.
+   * Ignored on machines with a single core.
+   *
+   * @param cells The number of cells (rows times columns), or 0 to always search on one thread.
+   */
+  void set_parallel_threshold(size_t cells);
+
+  /**
+   * @brief Check if the plan has moves left to play.
+   * @return False if the search found no path or every move was played.
+   */
+  bool has_next_move() const;
+
   /**
    * @brief Get the next move using the backtracking strategy.
-   * @return The next move direction.
+   * @return The next move direction, or the snake's direction once the plan is over.
    */
   MoveDir next_move();
 
+  /**
+   * @brief Build the Hamiltonian cycle of the bound level. Call it when the level starts.
+   * @return True if the level has a cycle through every reachable cell.
+   */
+  bool build_cycle();
+
+  /**
+   * @brief Check if the bound level has a Hamiltonian cycle.
+   * @return True if build_cycle found one.
+   */
+  bool has_cycle();
+
+  /**
+   * @brief Get the next move along the Hamiltonian cycle, in constant time.
+   *
+   * The body always lies on the stretch of the cycle between the tail and the
+   * head, so every cell ahead of the head and before the tail is free. The
+   * snake takes the neighbor that skips furthest ahead on the cycle without
+   * passing the pellet or reaching the tail, which keeps that true; if there
+   * is none it just follows the cycle.
+   *
+   * @return The next move direction.
+   */
+  MoveDir next_move_cycle();
+
   /**
    * @brief Get the next move randomly.
    * @return The next move direction.
@@ -79,6 +301,12 @@ public:
    * @param s Pointer to the snake.
    */
   void bind_snake(Snake *s);
+
+  /**
+   * @brief Bind the random engine used by the random strategy.
+   * @param gen Pointer to the random engine.
+   */
+  void bind_rng(std::mt19937 *gen);
 };
 
 #endif
\ No newline at end of file
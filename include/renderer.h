@@ -0,0 +1,191 @@
+/*!
+ * @brief This file contains the implementation of a Renderer class.
+ *
+ * The Renderer class composes each frame of the game (a few lines of text
+ * followed by the board) into a preallocated frame buffer and compares it
+ * with the previous frame. Only the lines and cells that changed are sent,
+ * using ANSI cursor moves, in a single write to a RenderBackend. Backends
+ * decide where the bytes go: the terminal, a file or nowhere at all.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file renderer.h
+ */
+
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Enum that represents the glyphs a board cell can show.
+ */
+enum glyph_e
+{
+    GLYPH_EMPTY = 0,
+    GLYPH_WALL,
+    GLYPH_HEAD_START,
+    GLYPH_HEAD_DEAD,
+    GLYPH_HEAD_RIGHT,
+    GLYPH_HEAD_LEFT,
+    GLYPH_HEAD_DOWN,
+    GLYPH_HEAD_UP,
+    GLYPH_BODY,
+    GLYPH_BODY_DEAD,
+    GLYPH_FOOD,
+    GLYPH_LIFE,
+    GLYPH_LOST_LIFE
+};
+
+/**
+ * @brief Get the text of a glyph.
+ * @param g The glyph.
+ * @return The UTF-8 text of the glyph.
+ */
+const char *glyph_text(glyph_e g);
+
+/**
+ * @class RenderBackend
+ * @brief Class that represents where the rendered bytes go.
+ */
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() {}
+
+    /**
+     * @brief Write a frame.
+     * @param data The bytes of the frame.
+     * @param n The number of bytes.
+     */
+    virtual void write(const char *data, size_t n) = 0;
+};
+
+/**
+ * @class TerminalBackend
+ * @brief Class that writes the frames to the standard output.
+ */
+class TerminalBackend : public RenderBackend
+{
+public:
+    void write(const char *data, size_t n) override;
+};
+
+/**
+ * @class FileBackend
+ * @brief Class that appends the frames, escape sequences included, to a file.
+ */
+class FileBackend : public RenderBackend
+{
+private:
+    std::FILE *file; //!< The file being written.
+
+public:
+    /**
+     * @brief Open the file, truncating it.
+     * @param path The path of the file.
+     */
+    explicit FileBackend(const std::string &path);
+    ~FileBackend();
+
+    /**
+     * @brief Check if the file was opened.
+     * @return True if the file can be written.
+     */
+    bool is_open() const;
+
+    void write(const char *data, size_t n) override;
+};
+
+/**
+ * @class NullBackend
+ * @brief Class that discards the frames, only counting their bytes.
+ */
+class NullBackend : public RenderBackend
+{
+private:
+    size_t bytes = 0; //!< The number of bytes discarded.
+
+public:
+    void write(const char *data, size_t n) override;
+
+    /**
+     * @brief Get the number of bytes written so far.
+     * @return The number of bytes.
+     */
+    size_t get_bytes() const;
+};
+
+/**
+ * @class Renderer
+ * @brief Class that composes frames and writes only their differences.
+ *
+ * Board glyphs are assumed to take one terminal column each.
+ */
+class Renderer
+{
+private:
+    RenderBackend *backend = nullptr; //!< Where the frames go.
+
+    std::vector<std::string> text;      //!< Lines of text above the board in the frame being composed.
+    std::vector<std::string> prev_text; //!< Lines of text of the last frame written.
+    std::vector<uint8_t> cells;         //!< Glyphs of the board in the frame being composed.
+    std::vector<uint8_t> prev_cells;    //!< Glyphs of the board in the last frame written.
+    size_t rows = 0;                    //!< Rows of the board in the frame being composed.
+    size_t cols = 0;                    //!< Columns of the board in the frame being composed.
+    size_t prev_rows = 0;               //!< Rows of the board in the last frame written.
+    size_t prev_cols = 0;               //!< Columns of the board in the last frame written.
+    bool has_prev = false;              //!< False until a frame is written or after invalidate.
+    std::string out;                    //!< The bytes of the frame, reused between frames.
+
+    /**
+     * @brief Append an ANSI cursor move to the output.
+     * @param row The 0-based screen row.
+     * @param col The 0-based screen column.
+     */
+    void move_to(size_t row, size_t col);
+
+public:
+    /**
+     * @brief Bind the backend the frames are written to.
+     * @param b Pointer to the backend.
+     */
+    void bind_backend(RenderBackend *b);
+
+    /**
+     * @brief Start composing a new frame.
+     * @param r The number of rows of the board.
+     * @param c The number of columns of the board.
+     */
+    void begin_frame(size_t r, size_t c);
+
+    /**
+     * @brief Add text above the board. Each '\n' ends a line.
+     * @param s The text.
+     */
+    void add_text(const std::string &s);
+
+    /**
+     * @brief Set the glyph of a board cell.
+     * @param r The row of the cell.
+     * @param c The column of the cell.
+     * @param g The glyph.
+     */
+    void set_cell(size_t r, size_t c, glyph_e g) { cells[r * cols + c] = g; }
+
+    /**
+     * @brief Write the frame, or only what changed since the last one.
+     */
+    void present();
+
+    /**
+     * @brief Force the next frame to be drawn in full, e.g. after the screen scrolled.
+     */
+    void invalidate();
+};
+
+#endif
@@ -0,0 +1,240 @@
+/*!
+ * @brief This file contains the replay log writer and reader.
+ *
+ * A replay log records everything a game draws from chance, so the game can
+ * be played again without the player or the random engine: the pellet
+ * positions and the move of every tick the snake runs, packed in 2 bits.
+ * Checksums of the game state are written every few ticks, so a replay
+ * knows the first tick where it stopped following the recorded game.
+ *
+ * All integers are little-endian:
+ *
+ * - "SNZR", version, hash of the levels (64-bit), seed (64-bit), lives,
+ *   food pellets per level, tick limit (64-bit), ticks between checksums;
+ * - then records, each one starting with a tag byte:
+ *   - 'M': number of moves, then 4 moves per byte, lowest bits first;
+ *   - 'P': row and column of a pellet, or NO_PELLET twice if none was placed;
+ *   - 'C': tick (64-bit) and checksum (64-bit) of the state after it;
+ *   - 'E': like 'C', for the tick the game ended.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file replay.h
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "level.h"
+#include "snake.h"
+
+/**
+ * @brief Struct that represents the game settings stored in a replay log.
+ */
+struct ReplayHeader
+{
+    uint64_t levels_hash;       //!< Hash of the levels, see hash_levels.
+    uint64_t seed;              //!< Seed of the recorded game.
+    uint32_t lives;             //!< Lives of the snake.
+    uint32_t food;              //!< Food pellets per level.
+    uint64_t max_ticks;         //!< Tick limit of the recorded game, 0 for none.
+    uint32_t checksum_interval; //!< Ticks between two checksums.
+};
+
+/**
+ * @class StateHash
+ * @brief Class that represents a 64-bit FNV-1a hash, fed a value at a time.
+ */
+class StateHash
+{
+private:
+    uint64_t h = 14695981039346656037ull; //!< The hash of what was added so far.
+
+public:
+    /**
+     * @brief Add the bytes of a buffer to the hash.
+     */
+    void add_bytes(const void *data, const size_t n) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < n; ++i)
+            h = (h ^ p[i]) * 1099511628211ull;
+    }
+
+    /**
+     * @brief Add an integer to the hash, as 8 little-endian bytes.
+     */
+    void add(const uint64_t v) {
+        for (int i = 0; i < 8; ++i)
+            h = (h ^ (v >> (8 * i) & 0xff)) * 1099511628211ull;
+    }
+
+    uint64_t value() const { return h; }
+};
+
+/**
+ * @brief Hash the size, spawn location and tiles of every level, as loaded.
+ *
+ * The same levels hash the same from a text or a precompiled file.
+ *
+ * @param levels The levels, before any pellet is placed.
+ * @return The hash.
+ */
+uint64_t hash_levels(const std::vector<Level> &levels);
+
+/**
+ * @brief Hash the size, spawn location and tiles of a single level, as loaded.
+ * @param level The level, before any pellet is placed.
+ * @return The hash.
+ */
+uint64_t hash_level(const Level &level);
+
+/**
+ * @class ReplayWriter
+ * @brief Class that represents a replay log being recorded.
+ *
+ * Moves are held until a record of another kind, or the end of the log,
+ * needs to be written after them.
+ */
+class ReplayWriter
+{
+private:
+    std::FILE *file = nullptr;   //!< The log file.
+    std::string out;             //!< Bytes not yet written to the file.
+    std::vector<uint8_t> moves;  //!< The moves not yet written, 2 bits each.
+    uint32_t n_moves = 0;        //!< The number of moves not yet written.
+    bool failed = false;         //!< True once a write to the file failed.
+
+    /**
+     * @brief Move the pending moves to the output buffer.
+     */
+    void flush_moves();
+
+    /**
+     * @brief Write the output buffer to the file.
+     */
+    void flush();
+
+public:
+    static const uint32_t CHECKSUM_INTERVAL = 64; //!< Default ticks between two checksums.
+    static const uint32_t NO_PELLET = 0xffffffff; //!< Row and column recorded when no pellet was placed.
+
+    ReplayWriter() = default;
+    ReplayWriter(const ReplayWriter &) = delete;
+    ReplayWriter &operator=(const ReplayWriter &) = delete;
+
+    /**
+     * @brief Flushes and closes the log.
+     */
+    ~ReplayWriter();
+
+    /**
+     * @brief Create the log file and write its header.
+     * @param path The path of the log.
+     * @param header The settings of the game.
+     * @return False if the file couldn't be created.
+     */
+    bool open(const std::string &path, const ReplayHeader &header);
+
+    /**
+     * @brief Flush and close the log.
+     * @return False if a write to the file failed, so the log is incomplete.
+     */
+    bool close();
+
+    bool is_open() const { return file != nullptr; }
+
+    /**
+     * @brief Record the move of a tick.
+     * @param dir The move, one of the four directions.
+     * @return False, recording nothing, if the move isn't one of the four directions.
+     */
+    bool move(const MoveDir dir);
+
+    /**
+     * @brief Record a pellet placement.
+     * @param placed False if the level had no room for a pellet.
+     * @param pos The position of the pellet.
+     */
+    void pellet(const bool placed, const TilePos pos);
+
+    /**
+     * @brief Record the checksum of the state after a tick.
+     * @param end True for the tick the game ended, which closes the log.
+     */
+    void checksum(const uint64_t tick, const uint64_t sum, const bool end);
+};
+
+/**
+ * @class ReplayReader
+ * @brief Class that represents a replay log being played back.
+ *
+ * The records must be read in the order they were written; reading a record
+ * of another kind than the next one fails, and so does reading past the end.
+ */
+class ReplayReader
+{
+private:
+    std::vector<uint8_t> data;  //!< The whole log.
+    size_t pos = 0;             //!< The next byte to be read.
+    uint32_t moves_left = 0;    //!< Moves left in the current 'M' record.
+    uint32_t move_index = 0;    //!< Index of the next move in the current 'M' record.
+    size_t moves_start = 0;     //!< Offset of the moves of the current 'M' record.
+    bool open_flag = false;     //!< True once a log was opened.
+
+    /**
+     * @brief Check the tag of the next record and skip it.
+     * @return False if the next record has another tag, or there is none.
+     */
+    bool take_tag(const char tag);
+
+    bool has(const size_t n) const { return data.size() - pos >= n; }
+    uint32_t u32();
+    uint64_t u64();
+
+public:
+    /**
+     * @brief Read a log file and its header.
+     *
+     * @throw std::runtime_error if the file can't be read or isn't a replay log.
+     * @param path The path of the log.
+     * @return The settings of the recorded game.
+     */
+    ReplayHeader open(const std::string &path);
+
+    bool is_open() const { return open_flag; }
+
+    /**
+     * @brief Read the move of the next tick.
+     * @param dir The move.
+     * @return False if the next record is not a move.
+     */
+    bool next_move(MoveDir &dir);
+
+    /**
+     * @brief Read the next pellet placement.
+     * @param placed False if the recorded level had no room for a pellet.
+     * @param loc The position of the pellet.
+     * @return False if the next record is not a pellet.
+     */
+    bool next_pellet(bool &placed, TilePos &loc);
+
+    /**
+     * @brief Read the next checksum.
+     * @param end True if it is the checksum of the tick the game ended.
+     * @return False if the next record is not a checksum.
+     */
+    bool next_checksum(uint64_t &tick, uint64_t &sum, bool &end);
+
+    /**
+     * @brief Check if the whole log was read, e.g. one whose recording was interrupted.
+     * @return True if there are no more records.
+     */
+    bool at_end() const { return moves_left == 0 && pos == data.size(); }
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*!
+ * @brief This file contains the implementation of a TickScheduler class.
+ *
+ * The TickScheduler class paces the game loop at a fixed number of ticks per
+ * second. Deadlines are absolute (each one is the previous deadline plus the
+ * period), so the time spent updating and rendering doesn't accumulate as
+ * drift. It also measures how late each wake up was.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file scheduler.h
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+
+/**
+ * @class TickScheduler
+ * @brief Class that represents a fixed-timestep clock for the game loop.
+ */
+class TickScheduler
+{
+private:
+    typedef std::chrono::steady_clock clock;
+
+    clock::duration period;       //!< The time between two ticks.
+    clock::time_point deadline;   //!< When the next tick is due.
+    bool started = false;         //!< False until the first wait after a reset.
+
+    unsigned long samples = 0;    //!< Number of wake ups measured.
+    double sum_ms = 0;            //!< Sum of the lateness of the wake ups.
+    double sum_sq_ms = 0;         //!< Sum of the squared lateness of the wake ups.
+    double max_ms = 0;            //!< Largest lateness of a wake up.
+
+    static const int MAX_LAG = 4; //!< Periods the clock may fall behind before it skips ahead.
+
+public:
+    /**
+     * @brief Set the number of ticks per second.
+     * @param tps The ticks per second.
+     */
+    void set_rate(const int tps);
+
+    /**
+     * @brief Start counting deadlines from now, e.g. after waiting for input.
+     */
+    void reset();
+
+    /**
+     * @brief Sleep until the next tick is due.
+     *
+     * If the loop fell more than MAX_LAG periods behind, the missed ticks are
+     * dropped instead of being run back to back.
+     */
+    void wait();
+
+    /**
+     * @brief Get the mean lateness of the wake ups.
+     * @return The mean jitter in milliseconds.
+     */
+    double mean_jitter_ms() const;
+
+    /**
+     * @brief Get the standard deviation of the lateness of the wake ups.
+     * @return The standard deviation in milliseconds.
+     */
+    double stddev_jitter_ms() const;
+
+    /**
+     * @brief Get the largest lateness of a wake up.
+     * @return The maximum jitter in milliseconds.
+     */
+    double max_jitter_ms() const;
+
+    /**
+     * @brief Get the number of wake ups measured.
+     * @return The number of samples.
+     */
+    unsigned long get_samples() const;
+};
+
+#endif
@@ -14,12 +14,23 @@
 #ifndef GAMESNAKE_H
 #define GAMESNAKE_H
 
+#include "async_planner.h"
 #include "level.h"
+#include "level_loader.h"
+#include "maze.h"
 #include "snake.h"
 // #include "randomsplayer.h"
 // #include "btsplayer.h"
+#include "plan_cache.h"
 #include "player.h"
+#include "renderer.h"
+#include "replay.h"
+#include "scheduler.h"
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <chrono>
+#include <random>
 
 namespace snz
 {
@@ -32,8 +43,27 @@ namespace snz
         int n_food_pellets_per_nivel = 10;        //<! The number of food pellets per level.
         unsigned short int lives = 5;             //<! The number of lives.
         int fps = 12;                             //<! The frames per second.
+        int tps = 0;                              //<! The ticks (updates) per second, 0 to follow fps.
         std::string player_type = "backtracking"; //<! The player type.
+        std::string heuristic = "distance";       //<! The heuristic of the astar player.
         std::string file_name;                    //<! The file name.
+        bool headless = false;                    //<! Run at full speed without output or input waits.
+        unsigned long max_ticks = 0;              //<! End the game after this many ticks, 0 for no limit.
+        unsigned long seed = 0;                   //<! The seed of the random engine.
+        bool has_seed = false;                    //<! False to draw the seed from std::random_device.
+        std::string render = "terminal";          //<! The render backend: terminal, file or null.
+        std::string render_file = "snaze_render.log"; //<! The file written by the file backend.
+        size_t generate_rows = 0;                 //<! Rows of the generated maze, 0 to read the level file instead.
+        size_t generate_cols = 0;                 //<! Columns of the generated maze.
+        std::string stats_file;                   //<! File the run statistics are written to, empty for none.
+        unsigned long stats_interval = 0;         //<! Ticks between two statistics snapshots, 0 to write only at exit.
+        std::string record_file;                  //<! File the replay log is recorded to, empty for none.
+        std::string replay_file;                  //<! Replay log played back instead of the player, empty for none.
+        bool render_set = false;                  //<! True if --render or --render-file was given.
+        size_t parallel_threshold = 1 << 18;      //<! Board cells from which the BFS planner runs on every core, 0 for never.
+        std::string planner;                      //<! Where the player searches: sync, async, or empty to decide from the other options.
+        std::string plan_cache_file;              //<! File the plan cache is loaded from and saved to, empty for none.
+        size_t plan_cache_size = 4096;            //<! The most plans kept in the cache, 0 to search every time.
     };
 
     /**
@@ -67,6 +97,40 @@ namespace snz
         std::string msg;          //<! The message of the result.
     };
 
+    /**
+     * @brief Struct that represents the outcome of a finished (or running) game.
+     */
+    struct SimulationSummary
+    {
+        float score;            //<! The score of the player.
+        int pellets;            //<! The number of pellets eaten in all levels.
+        unsigned short lives;   //<! The number of lives left.
+        int crashes;            //<! The number of times the snake crashed.
+        unsigned long ticks;    //<! The number of calls to update.
+        unsigned long seed;     //<! The seed of the random engine.
+        double wall_ms;         //<! The wall time since the first update, in milliseconds.
+        bool won;               //<! True if all levels were cleared.
+    };
+
+    /**
+     * @brief Struct that represents the counters kept on the hot paths during a run.
+     */
+    struct SimulationStats
+    {
+        unsigned long planner_calls = 0;          //<! Number of searches run by the player.
+        unsigned long plan_cache_hits = 0;        //<! Number of plans taken from the plan cache instead of searched.
+        unsigned long plan_cache_misses = 0;      //<! Number of plans looked up in the plan cache and not found.
+        unsigned long nodes_expanded = 0;         //<! Nodes expanded by all the searches.
+        size_t peak_frontier = 0;                 //<! Largest queue or open list of a search.
+        size_t peak_visited = 0;                  //<! Largest closed set of a search.
+        double thinking_ms = 0;                   //<! Time spent in updates of the THINKING state.
+        double run_ms = 0;                        //<! Time spent in updates of the RUN state.
+        double render_ms = 0;                     //<! Time spent rendering.
+        unsigned long pellets_placed = 0;         //<! Number of pellets placed.
+        double pellet_ms = 0;                     //<! Time spent placing pellets.
+        std::vector<unsigned long> ticks_per_life; //<! Ticks lived by each life that ended.
+    };
+
     /**
      * @class SnakeSimulation
      * @brief Class that represents the simulation.
@@ -81,8 +145,31 @@ namespace snz
         std::vector<Level>::iterator running_level; //<! Iterator to the current level.
         simulation_state_e state;                   //<! The current state of the simulation.
         int consumed_pellets = 0;                   //<! The number of consumed pellets.
+        int total_pellets = 0;                      //<! The number of consumed pellets in all levels.
+        int crashes = 0;                            //<! The number of times the snake crashed.
+        bool won = false;                           //<! True once the last level is cleared.
+        unsigned long ticks = 0;                    //<! The number of calls to update.
+        std::chrono::steady_clock::time_point start_time; //<! The moment of the first update.
         float score = 0;                            //<! The score of the player.
         RunningOptions opt;                         //<! The running options.
+        std::mt19937 rng;                           //<! The random engine shared by the level and the player.
+        Renderer renderer;                          //<! Composes the frames and writes what changed.
+        std::unique_ptr<RenderBackend> backend;     //<! Where the frames are written.
+        TickScheduler scheduler;                    //<! Paces the ticks of the game loop.
+        unsigned long render_every = 1;             //<! Ticks between two frames while running.
+        SimulationStats stats;                      //<! The counters of the run.
+        unsigned long life_start = 0;               //<! The tick the current life started at, 0 between lives.
+        std::ofstream stats_out;                    //<! Where the statistics are written, if --stats was given.
+        ReplayWriter recorder;                      //<! The replay log being recorded, if --record was given.
+        ReplayReader replayer;                      //<! The replay log being played back, if --replay was given.
+        uint32_t checksum_interval = ReplayWriter::CHECKSUM_INTERVAL; //<! Ticks between two replay checksums.
+        std::string replay_msg;                     //<! Why the replay stopped, empty while it runs.
+        bool replay_error = false;                  //<! True if the replay stopped following the log or the recording failed.
+        std::unique_ptr<AsyncPlanner> planner;      //<! Searches on a worker thread while the frames go on, if enabled.
+        PlanCache plan_cache;                       //<! The plans of the states searched before.
+        std::vector<uint64_t> level_keys;           //<! Hash of each level as loaded, for the plan cache.
+        bool save_plan_cache = false;               //<! True once the plan cache file was loaded, so it is saved at exit.
+        bool cached_ready = false;                  //<! True if the plan of the THINKING state came from the cache, not the planner.
 
         /**
          * @brief Read the levels from a file.
@@ -95,7 +182,71 @@ namespace snz
         void init_running_level();
 
         /**
-         * @brief Render the board.
+         * @brief Place a pellet in the running level, timing it.
+         */
+        void place_pellet();
+
+        /**
+         * @brief Check if the player type searches for a plan before running.
+         * @return False for the random player and for a cycle player that has its cycle.
+         */
+        bool needs_plan();
+
+        /**
+         * @brief Run the search of the player type and add its counters to the statistics.
+         */
+        void plan();
+
+        /**
+         * @brief Describe the state the next search starts from, for the plan cache.
+         * @param state The state, with its Zobrist key.
+         * @return False if its plan can't be cached: the cache is off, the snake is too long or no pellet was placed.
+         */
+        bool plan_state(PlanState &state);
+
+        /**
+         * @brief Give the player the cached plan of a state, counting the hit or the miss.
+         * @param state The state.
+         * @return True if the plan was in the cache.
+         */
+        bool use_cached_plan(const PlanState &state);
+
+        /**
+         * @brief Add the counters of the last search of a player to the statistics.
+         * @param p The player.
+         */
+        void record_search(Player &p);
+
+        /**
+         * @brief Advance the game state by one tick.
+         */
+        void advance();
+
+        /**
+         * @brief Hash the state of the game that a replay must reproduce.
+         * @return The checksum.
+         */
+        uint64_t state_checksum();
+
+        /**
+         * @brief Write or check the replay checksum of the tick just run, if one is due.
+         */
+        void check_replay();
+
+        /**
+         * @brief Stop the replay because the game no longer follows the log.
+         * @param reason What didn't match.
+         */
+        void replay_mismatch(const std::string &reason);
+
+        /**
+         * @brief Append the statistics to the stats file as a single line of JSON.
+         * @param final True for the snapshot written at exit.
+         */
+        void write_stats(bool final);
+
+        /**
+         * @brief Compose the status line and the board into the current frame.
          */
         void render_board();
 
@@ -132,6 +283,16 @@ namespace snz
          */
         void print_welcome();
 
+        /**
+         * @brief Print the tick rate and the jitter measured by the scheduler.
+         */
+        void print_timing();
+
+        /**
+         * @brief Print the summary of the game as a single line of JSON.
+         */
+        void print_summary();
+
         /**
          * @brief Print the game options.
          */
@@ -140,6 +301,11 @@ namespace snz
     public:
         // ~SnakeSimulation() { delete player; }
 
+        /**
+         * @brief Write the last statistics snapshot and save the plan cache, if asked to.
+         */
+        ~SnakeSimulation();
+
         /**
          * @brief Update the game state.
          */
@@ -160,14 +326,44 @@ namespace snz
 
         /**
          * @brief Render the game based on the current state.
+         *
+         * While the snake runs only every k-th tick is drawn, k being tps / fps.
          */
         void render();
 
+        /**
+         * @brief Make the next render draw the whole frame instead of what changed.
+         */
+        void invalidate_frame();
+
+        /**
+         * @brief Sleep until the next tick is due. Does nothing in headless mode.
+         */
+        void wait_next_tick();
+
         /**
          * @brief Check if the game is over.
          * @return True if the game is over, false otherwise.
          */
         bool game_over();
+
+        /**
+         * @brief Get the summary of the game so far.
+         * @return A SimulationSummary.
+         */
+        SimulationSummary summary();
+
+        /**
+         * @brief Get the statistics of the run so far.
+         * @return A SimulationStats.
+         */
+        const SimulationStats &get_stats() const;
+
+        /**
+         * @brief Check if a replay stopped following its log, or a recording couldn't be written.
+         * @return True if the replay diverged from the recorded game or the log is incomplete.
+         */
+        bool replay_failed() const;
     };
 
 };
@@ -13,9 +13,11 @@
 #ifndef SNAKE_H
 #define SNAKE_H
 
-#include <deque>
+#include <cstddef>
+#include <vector>
 
 #include "level.h"
+#include "zobrist.h"
 
 /**
  * @brief Struct that represents a move direction.
@@ -56,6 +58,59 @@ struct MoveDir
     }
 };
 
+/**
+ * @class BodyView
+ * @brief Class that represents a non-owning, read-only view of the snake's body.
+ *
+ * Segment 0 is the head and segment size() - 1 is the tail. The view is only
+ * valid until the snake moves again.
+ */
+class BodyView
+{
+private:
+    const TilePos *ring; // <! The ring buffer of the snake.
+    size_t capacity;     // <! The capacity of the ring buffer.
+    size_t head;         // <! Index of the head in the ring buffer.
+    size_t length;       // <! Number of segments.
+
+public:
+    /**
+     * @brief Class that represents an iterator from the head to the tail.
+     */
+    class iterator
+    {
+    private:
+        const BodyView *view; // <! The view being iterated.
+        size_t i;             // <! The current segment.
+
+    public:
+        iterator(const BodyView *v, size_t idx) : view(v), i(idx) {}
+        const TilePos &operator*() const { return (*view)[i]; }
+        iterator &operator++() { ++i; return *this; }
+        bool operator!=(const iterator &other) const { return i != other.i; }
+    };
+
+    BodyView(const TilePos *r, size_t cap, size_t h, size_t len) : ring(r), capacity(cap), head(h), length(len) {}
+
+    /**
+     * @brief Get a segment of the body.
+     * @param i Index of the segment, 0 being the head.
+     * @return The position of the segment.
+     */
+    const TilePos &operator[](size_t i) const
+    {
+        size_t idx = head + i;
+        return ring[idx < capacity ? idx : idx - capacity];
+    }
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const TilePos &front() const { return (*this)[0]; }
+    const TilePos &back() const { return (*this)[length - 1]; }
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, length); }
+};
+
 /**
  * @class Snake
  * @brief Class that represents a snake.
@@ -63,10 +118,20 @@ struct MoveDir
 class Snake
 {
 private:
-    std::deque<TilePos> body;     // <! Vector of TilePos that represents the snake's body.
+    std::vector<TilePos> ring;    // <! Ring buffer with the snake's body; it only grows, and is kept between levels.
+    size_t head = 0;              // <! Index of the head in the ring buffer.
+    size_t length = 0;            // <! Number of segments of the body.
     MoveDir dir;                  // <! Direction the snake is facing.
     unsigned short int lives = 5; // <! Number of lives the snake has.
     Level *running_level;         // <! Pointer to the level the snake is currently in.
+    uint64_t body_key = 0;        // <! Zobrist key of the cells of the body, updated as the snake moves.
+
+    static const size_t MIN_RING = 64; // <! Initial capacity of the ring buffer.
+
+    /**
+     * @brief Doubles the capacity of the ring buffer, moving the head to its first slot.
+     */
+    void grow_ring();
 
 public:
     /**
@@ -76,16 +141,40 @@ public:
     void step_foward(MoveDir d);
 
     /**
-     * @brief Get the snake's body.
-     * @return Deque of TilePos that represents the snake's body.
+     * @brief Get the snake's body without copying it.
+     * @return A view of the body, from the head to the tail.
+     */
+    BodyView get_body() const;
+
+    /**
+     * @brief Get the position of the snake's head.
+     * @return The position of the head.
+     */
+    TilePos get_head() const;
+
+    /**
+     * @brief Get the position of the snake's tail.
+     * @return The position of the tail.
      */
-    std::deque<TilePos> get_body();
+    TilePos get_tail() const;
+
+    /**
+     * @brief Get the number of segments of the snake.
+     * @return The size of the body.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the Zobrist key of the cells taken by the body, head included.
+     * @return The xor of the zobrist_key of every segment.
+     */
+    uint64_t get_body_key() const;
 
     /**
      * @brief Get the snake's direction.
      * @return Direction the snake is facing.
      */
-    MoveDir get_dir();
+    MoveDir get_dir() const;
 
     /**
      * @brief Get the snake's lives.
@@ -113,10 +202,20 @@ public:
     TilePos get_next_location(MoveDir d);
 
     /**
-     * @brief Initializes the snake.
+     * @brief Initializes the snake at the spawn location of its level.
+     *
+     * The ring buffer starts small and doubles when the snake outgrows it, so
+     * a short snake on a huge board doesn't pay for the whole board.
      */
     void init();
 
+    /**
+     * @brief Replaces the snake's body and direction, e.g. with a copy of another snake's.
+     * @param body The segments, from the head to the tail.
+     * @param d Direction the snake is facing.
+     */
+    void set_body(const std::vector<TilePos> &body, const MoveDir d);
+
     /**
      * @brief Binds the snake to a level.
      * @param l Pointer to the level.
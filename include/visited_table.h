@@ -0,0 +1,136 @@
+/*!
+ * @brief This file contains the implementation of a VisitedTable class.
+ *
+ * The VisitedTable class is the closed set used by the planners. Each search
+ * state is packed into a single integer key and marked in a bitset, so the
+ * table takes one bit per key even on the largest boards. The words touched
+ * by a search are remembered, so clearing the table between searches only
+ * costs as much as the search itself and a replan never allocates once the
+ * table is large enough.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file visited_table.h
+ */
+
+#ifndef VISITED_TABLE_H
+#define VISITED_TABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @class VisitedTable
+ * @brief Class that represents a bitset of integer keys that is cheap to clear.
+ */
+class VisitedTable
+{
+private:
+    std::vector<uint64_t> words;   //!< The bits of the keys, 64 keys per word.
+    std::vector<uint32_t> touched; //!< The words with some bit set since the last reset.
+    size_t count = 0;              //!< Number of keys inserted since the last reset.
+
+public:
+    /**
+     * @brief Empties the table and makes room for keys in [0, n_keys).
+     * @param n_keys The number of distinct keys the next search may use.
+     */
+    void reset(const size_t n_keys);
+
+    /**
+     * @brief Inserts a key in the table.
+     * @param key The key to be inserted.
+     * @return True if the key was not in the table, false otherwise.
+     */
+    bool insert(const size_t key)
+    {
+        uint64_t &word = words[key >> 6];
+        uint64_t bit = uint64_t(1) << (key & 63);
+        if (word & bit)
+            return false;
+
+        if (word == 0)
+            touched.push_back(key >> 6);
+        word |= bit;
+        ++count;
+        return true;
+    }
+
+    /**
+     * @brief Checks if a key is in the table.
+     * @param key The key to be checked.
+     * @return True if the key is in the table, false otherwise.
+     */
+    bool contains(const size_t key) const { return words[key >> 6] >> (key & 63) & 1; }
+
+    /**
+     * @brief Get the number of keys in the table.
+     * @return The number of keys inserted since the last reset.
+     */
+    size_t size() const { return count; }
+};
+
+/**
+ * @class ConcurrentVisitedTable
+ * @brief Class that represents a bitset of integer keys that many threads insert into at once.
+ *
+ * Bits are set with an atomic or, without locks. Each thread keeps its own
+ * list of touched words, so it is just as cheap to clear as VisitedTable.
+ */
+class ConcurrentVisitedTable
+{
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> words; //!< The bits of the keys, 64 keys per word.
+    size_t n_words = 0;                             //!< The number of words allocated.
+    std::vector<std::vector<uint32_t>> touched;     //!< The words each thread found empty since the last reset.
+    std::vector<size_t> counts;                     //!< The keys each thread inserted since the last reset.
+
+public:
+    /**
+     * @brief Empties the table and makes room for keys in [0, n_keys). Not thread safe.
+     * @param n_keys The number of distinct keys the next search may use.
+     * @param n_threads The number of threads that will insert keys.
+     */
+    void reset(const size_t n_keys, const unsigned n_threads);
+
+    /**
+     * @brief Inserts a key in the table.
+     * @param key The key to be inserted.
+     * @param thread The number of the calling thread, in [0, n_threads).
+     * @return True if the key was not in the table, false otherwise.
+     */
+    bool insert(const size_t key, const unsigned thread)
+    {
+        uint64_t bit = uint64_t(1) << (key & 63);
+        uint64_t old = words[key >> 6].fetch_or(bit, std::memory_order_relaxed);
+        if (old == 0)
+            touched[thread].push_back(key >> 6);
+        if (old & bit)
+            return false;
+
+        ++counts[thread];
+        return true;
+    }
+
+    /**
+     * @brief Checks if a key is in the table.
+     *
+     * Keys inserted by other threads are only seen once those threads are
+     * synchronized with the caller, e.g. at the end of WorkerPool::run.
+     *
+     * @param key The key to be checked.
+     * @return True if the key is in the table, false otherwise.
+     */
+    bool contains(const size_t key) const { return words[key >> 6].load(std::memory_order_relaxed) >> (key & 63) & 1; }
+
+    /**
+     * @brief Get the number of keys in the table. Not thread safe.
+     * @return The number of keys inserted since the last reset.
+     */
+    size_t size() const;
+};
+
+#endif
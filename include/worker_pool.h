@@ -0,0 +1,76 @@
+/*!
+ * @brief This file contains the implementation of a WorkerPool class.
+ *
+ * The WorkerPool class keeps a few threads parked between jobs, so a job that
+ * is split across them many times in a row (e.g. once per layer of a breadth
+ * first search) doesn't pay for starting threads each time. The thread that
+ * runs a job takes part in it as worker 0.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file worker_pool.h
+ */
+
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkerPool
+ * @brief Class that represents a fixed set of threads that run a job together.
+ */
+class WorkerPool
+{
+private:
+    std::vector<std::thread> threads;          //!< The workers other than the caller.
+    std::mutex mutex;                          //!< Guards everything below.
+    std::condition_variable wake;              //!< Signals a new job or the shutdown.
+    std::condition_variable done;              //!< Signals that the last worker finished.
+    const std::function<void(unsigned)> *job = nullptr; //!< The job being run.
+    unsigned long generation = 0;              //!< Number of jobs started.
+    unsigned pending = 0;                      //!< Workers still running the job.
+    bool stopping = false;                     //!< True once the pool is being destroyed.
+
+    /**
+     * @brief The loop of a worker: wait for a job, run it, report.
+     * @param id The number of the worker, from 1.
+     */
+    void work(unsigned id);
+
+public:
+    /**
+     * @brief Start the workers.
+     * @param n The number of workers, the caller of run included.
+     */
+    explicit WorkerPool(unsigned n);
+
+    /**
+     * @brief Stop and join the workers.
+     */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * @brief Get the number of workers, the caller of run included.
+     * @return The number of workers.
+     */
+    unsigned size() const;
+
+    /**
+     * @brief Run job(id) on every worker, id in [0, size()), and wait for all of them.
+     *
+     * Everything the job writes is visible to the caller when run returns.
+     *
+     * @param f The job.
+     */
+    void run(const std::function<void(unsigned)> &f);
+};
+
+#endif
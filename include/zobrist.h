@@ -0,0 +1,67 @@
+/*!
+ * @brief This file contains the Zobrist keys of the board cells.
+ *
+ * The key of a set of cells is the xor of the keys of its cells, so adding
+ * or removing a cell updates it in constant time. The keys are drawn from a
+ * splitmix64 of the position rather than stored in a table, so they cost no
+ * memory on large boards and are the same on every run.
+ *
+ * @author Tobias dos Santos Neto e Wisla Alves Argolo
+ * @date July 16st, 2023.
+ * @file zobrist.h
+ */
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <cstdint>
+
+#include "level.h"
+
+/**
+ * @brief Scramble a 64-bit value with the splitmix64 finalizer.
+ * @param x The value.
+ * @return The scrambled value.
+ */
+inline uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief What a Zobrist key stands for; the same cell has another key for each.
+ */
+enum zobrist_kind_e
+{
+    ZOBRIST_BODY,   //!< A cell taken by the snake.
+    ZOBRIST_HEAD,   //!< The cell of the snake's head.
+    ZOBRIST_PELLET, //!< The cell of the pellet.
+    ZOBRIST_DIR     //!< The snake's direction, by its move code.
+};
+
+/**
+ * @brief Get the Zobrist key of a cell.
+ * @param pos The position of the cell.
+ * @param kind What the cell holds.
+ * @return The key.
+ */
+inline uint64_t zobrist_key(const TilePos pos, const zobrist_kind_e kind = ZOBRIST_BODY)
+{
+    // Rows and columns stay far below 2^30, so the kind has the top bits to itself.
+    return splitmix64(static_cast<uint64_t>(kind) << 62 | static_cast<uint64_t>(pos.row) << 32 | pos.col);
+}
+
+/**
+ * @brief Get the Zobrist key of a direction.
+ * @param code The move code of the direction, 0 to 3, or 4 for the neutral direction.
+ * @return The key.
+ */
+inline uint64_t zobrist_dir_key(const unsigned code)
+{
+    return splitmix64(static_cast<uint64_t>(ZOBRIST_DIR) << 62 | code);
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include "../include/async_planner.h"
+
+AsyncPlanner::AsyncPlanner() : ready(false) {
+    snake.bind_level(&level);
+    player.bind_level(&level);
+    player.bind_snake(&snake);
+    player.bind_rng(&rng);
+
+    worker = std::thread(&AsyncPlanner::work, this);
+}
+
+AsyncPlanner::~AsyncPlanner() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+void AsyncPlanner::configure(bool use_astar, heuristic_e h, size_t parallel_threshold) {
+    std::lock_guard<std::mutex> lock(mutex);
+    astar = use_astar;
+    player.set_heuristic(h);
+    player.set_parallel_threshold(parallel_threshold);
+}
+
+void AsyncPlanner::load_level(const Level &l) {
+    std::lock_guard<std::mutex> lock(mutex);
+    level.copy_layout(l);
+    snake.init();
+}
+
+void AsyncPlanner::request(const Snake &s, const TilePos pellet_loc) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        body.clear();
+        for (const auto &tile_pos : s.get_body())
+            body.push_back(tile_pos);
+        dir = s.get_dir();
+        pellet = pellet_loc;
+        ready.store(false, std::memory_order_relaxed);
+        has_request = true;
+    }
+
+    pending = true;
+    wake.notify_one();
+}
+
+bool AsyncPlanner::busy() const {
+    return pending;
+}
+
+bool AsyncPlanner::poll() {
+    if (!pending || !ready.load(std::memory_order_acquire))
+        return false;
+
+    pending = false;
+    return true;
+}
+
+Player &AsyncPlanner::get_player() {
+    return player;
+}
+
+void AsyncPlanner::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        wake.wait(lock, [&]() { return stopping || has_request; });
+        if (stopping) return;
+        has_request = false;
+
+        // The old pellet goes first: the snake may be on it now.
+        TilePos old = level.get_pellet_loc();
+        if (level.get_tile_type(old) == tile_type_e::FOOD)
+            level.set_tile_type(old, tile_type_e::EMPTY);
+        snake.set_body(body, dir);
+        level.place_pellet_at(pellet);
+
+        // The copies are only touched by this thread until the plan is published.
+        lock.unlock();
+        if (astar)
+            player.find_solution_astar();
+        else
+            player.find_solution();
+        ready.store(true, std::memory_order_release);
+        lock.lock();
+    }
+}
@@ -0,0 +1,426 @@
+/**!
+ *  This program runs microbenchmarks of the Snaze simulation hot paths.
+ *
+ *  Each benchmark runs against every level of the given files (by default,
+ *  every .dat file in ./assets) plus a few synthetic boards and a large
+ *  generated maze, and prints one JSON line with the time and heap
+ *  allocations per operation.
+ *
+ *  To compile: use cmake script.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // EXIT_SUCCESS
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+#include "../include/level_loader.h"
+#include "../include/maze.h"
+#include "../include/move_code.h"
+#include "../include/simulation.h"
+
+namespace
+{
+    //! Number of calls to operator new since the program started, from any thread.
+    std::atomic<unsigned long> allocations{0};
+}
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    /**
+     * @brief Struct that represents the benchmark options.
+     */
+    struct BenchOptions
+    {
+        double min_ms = 100;            //<! Minimum time spent measuring each benchmark.
+        std::string filter;             //<! Only run the benchmarks whose name contains it.
+        std::vector<std::string> files; //<! Level files to be measured.
+    };
+
+    /**
+     * @brief Struct that represents the outcome of a benchmark.
+     */
+    struct Measure
+    {
+        unsigned long ops = 0; //<! Number of operations measured.
+        double seconds = 0;    //<! Time spent in them.
+        unsigned long allocs;  //<! Heap allocations made by them.
+    };
+
+    BenchOptions opt;
+
+    std::string usage()
+    {
+        std::ostringstream oss;
+        oss << "Usage: snaze_bench [<options>] [<input_level_file> ...]\n"
+            << "   Benchmark options:\n"
+            << "       --help                  Print this help text.\n"
+            << "       --min-ms <num>          Minimum time spent measuring each benchmark. Default = 100.\n"
+            << "       --filter <name>         Only run the benchmarks whose name contains <name>.\n"
+            << "   Without level files every .dat file in ./assets is used.\n";
+        return oss.str();
+    }
+
+    /**
+     * @brief Run an operation in batches of doubling size until opt.min_ms has passed.
+     * @param op The operation.
+     * @return The number of operations, the time and the allocations.
+     */
+    template <typename Op>
+    Measure measure(Op op)
+    {
+        op(); // warm up caches and reusable buffers
+
+        Measure m;
+        unsigned long batch = 1;
+        unsigned long allocs_before = allocations.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+
+        while (true)
+        {
+            for (unsigned long i{0}; i < batch; ++i)
+                op();
+            m.ops += batch;
+            m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (m.seconds * 1000 >= opt.min_ms)
+                break;
+            batch *= 2;
+        }
+
+        m.allocs = allocations.load(std::memory_order_relaxed) - allocs_before;
+        return m;
+    }
+
+    /**
+     * @brief Print a benchmark result as a JSON line.
+     * @param nodes Nodes expanded per operation, or 0 if the benchmark doesn't search.
+     */
+    void report(const std::string &bench, const std::string &board, const Measure &m, double nodes = 0)
+    {
+        std::cout << "{\"bench\": \"" << bench << "\", \"board\": \"" << board << "\", \"ops\": " << m.ops
+                  << ", \"ns_per_op\": " << m.seconds * 1e9 / m.ops
+                  << ", \"allocs_per_op\": " << static_cast<double>(m.allocs) / m.ops;
+        if (nodes > 0)
+            std::cout << ", \"nodes_per_sec\": " << nodes * m.ops / m.seconds;
+        std::cout << "}\n";
+    }
+
+    bool wanted(const std::string &bench)
+    {
+        return bench.find(opt.filter) != std::string::npos;
+    }
+
+    /**
+     * @brief Grow the snake by following the planner for a few pellets, so searches have a body to avoid.
+     *
+     * If the planner gets stuck the snake starts over from the spawn, like after
+     * a crash. Either way a pellet is left on the board.
+     */
+    void grow(Level &level, Snake &snake, Player &player, std::mt19937 &rng, int pellets)
+    {
+        for (int p{0}; p < pellets; ++p)
+        {
+            level.place_pellet(rng);
+            player.find_solution();
+
+            std::vector<MoveDir> solution = player.get_solution();
+            if (solution.empty())
+            {
+                for (const auto &tile_pos : snake.get_body())
+                    level.set_tile_type(tile_pos, tile_type_e::EMPTY);
+                snake.init();
+                return;
+            }
+
+            for (auto d : solution)
+            {
+                snake.set_dir(d);
+                snake.step_foward(d);
+            }
+        }
+
+        level.place_pellet(rng);
+    }
+
+    void bench_level(const Level &original, const std::string &board)
+    {
+        std::mt19937 rng(1);
+
+        if (wanted("find_solution"))
+        {
+            Level level = original;
+            Snake snake;
+            Player player;
+            snake.bind_level(&level);
+            player.bind_level(&level);
+            player.bind_snake(&snake);
+            player.bind_rng(&rng);
+            snake.init();
+
+            grow(level, snake, player, rng, 8);
+
+            player.find_solution();
+            double nodes = player.get_nodes_expanded();
+            report("find_solution", board, measure([&]() { player.find_solution(); }), nodes);
+
+            player.set_parallel_threshold(1);
+            player.find_solution();
+            report("find_solution_parallel", board, measure([&]() { player.find_solution(); }), nodes);
+            player.set_parallel_threshold(0);
+
+            player.find_solution_astar();
+            nodes = player.get_nodes_expanded();
+            report("find_solution_astar", board, measure([&]() { player.find_solution_astar(); }), nodes);
+        }
+
+        if (wanted("region_size"))
+        {
+            Level level = original;
+            Snake snake;
+            Player player;
+            snake.bind_level(&level);
+            player.bind_level(&level);
+            player.bind_snake(&snake);
+            player.bind_rng(&rng);
+            snake.init();
+
+            // The empty board, then around the body of a grown snake.
+            size_t sink = level.region_size(snake.get_head());
+            report("region_size", board, measure([&]() { sink += level.region_size(snake.get_head()); }));
+            grow(level, snake, player, rng, 8);
+            report("region_size_snake", board, measure([&]() { sink += level.region_size(snake.get_head()); }));
+            if (sink == 0)
+                std::cerr << board << ": no region around the head\n";
+        }
+
+        if (wanted("place_pellet"))
+        {
+            Level level = original;
+            Snake snake;
+            snake.bind_level(&level);
+            snake.init();
+
+            report("place_pellet", board, measure([&]() {
+                       level.place_pellet(rng);
+                       level.set_tile_type(level.get_pellet_loc(), tile_type_e::EMPTY);
+                   }));
+        }
+
+        if (wanted("empty_spaces"))
+        {
+            Level level = original;
+            size_t sink = 0;
+            report("empty_spaces", board, measure([&]() { sink += level.empty_spaces().size(); }));
+            if (sink == 0)
+                std::cerr << board << ": no empty spaces\n";
+        }
+
+        if (wanted("step_foward"))
+        {
+            Level level = original;
+            Snake snake;
+            snake.bind_level(&level);
+            snake.init();
+
+            // A one-segment snake stepping back and forth next to the spawn.
+            for (auto d : MOVE_CODES)
+            {
+                if (level.crashed(snake.get_next_location(d)))
+                    continue;
+
+                MoveDir back = {static_cast<short>(-d.dx), static_cast<short>(-d.dy)};
+                bool forth = true;
+                report("step_foward", board, measure([&]() {
+                           snake.step_foward(forth ? d : back);
+                           forth = !forth;
+                       }));
+                break;
+            }
+        }
+    }
+
+    void bench_file(const std::string &path, const std::string &name)
+    {
+        std::vector<Level> levels;
+        try
+        {
+            load_levels(path, levels);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << name << ": " << e.what();
+            return;
+        }
+
+        if (wanted("load_levels"))
+            report("load_levels", name, measure([&]() {
+                       std::vector<Level> loaded;
+                       load_levels(path, loaded);
+                   }));
+
+        if (wanted("render_board"))
+        {
+            // The whole frame (HUD and board) of the first level, drawn in full into the null backend.
+            // The sync planner keeps the search off the clock and the snake in RUN.
+            std::vector<std::string> args = {"snaze_bench", "--render", "null", "--planner", "sync", "--seed", "1", path};
+            std::vector<char *> argv;
+            for (auto &a : args)
+                argv.push_back(&a[0]);
+
+            snz::SnakeSimulation simulation;
+            if (simulation.initialize(argv.size(), argv.data()).type == snz::simulation_result_e::OK)
+            {
+                simulation.update(); // START -> THINKING
+                simulation.update(); // THINKING -> RUN
+                report("render_board", name, measure([&]() {
+                           simulation.invalidate_frame();
+                           simulation.render();
+                       }));
+            }
+        }
+
+        for (size_t l{0}; l < levels.size(); ++l)
+            bench_level(levels[l], name + "#" + std::to_string(l + 1));
+    }
+
+    /**
+     * @brief Write the synthetic boards to a temporary level file.
+     * @return The path of the file, or an empty string if it couldn't be written.
+     */
+    std::string write_synthetic()
+    {
+        std::ostringstream oss;
+        const size_t side = 100;
+
+        // An open arena and a board with a quarter of its cells walled, seeded.
+        std::mt19937 rng(42);
+        std::bernoulli_distribution wall(0.25);
+        for (int board{0}; board < 2; ++board)
+        {
+            oss << side << " " << side << "\n";
+            for (size_t r{0}; r < side; ++r)
+            {
+                for (size_t c{0}; c < side; ++c)
+                {
+                    bool border = r == 0 || c == 0 || r == side - 1 || c == side - 1;
+                    if (r == side / 2 && c == side / 2)
+                        oss << '*';
+                    else if (border || (board == 1 && wall(rng)))
+                        oss << '#';
+                    else
+                        oss << ' ';
+                }
+                oss << "\n";
+            }
+        }
+
+        char path[] = "/tmp/snaze_bench_XXXXXX";
+        int fd = mkstemp(path);
+        if (fd < 0)
+            return "";
+
+        std::string text = oss.str();
+        bool ok = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+        close(fd);
+        if (!ok)
+        {
+            unlink(path);
+            return "";
+        }
+        return path;
+    }
+
+    std::vector<std::string> asset_files()
+    {
+        std::vector<std::string> files;
+        if (DIR *dir = opendir("assets"))
+        {
+            while (dirent *entry = readdir(dir))
+            {
+                std::string name = entry->d_name;
+                if (name.size() > 4 && name.compare(name.size() - 4, 4, ".dat") == 0)
+                    files.push_back("assets/" + name);
+            }
+            closedir(dir);
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string str = argv[i];
+        bool has_value = i + 1 < argc;
+
+        try
+        {
+            if (str == "--help" || str == "--h")
+            {
+                std::cout << usage();
+                return EXIT_SUCCESS;
+            }
+            else if (str == "--min-ms" && has_value)
+                opt.min_ms = std::stod(argv[++i]);
+            else if (str == "--filter" && has_value)
+                opt.filter = argv[++i];
+            else if (str.compare(0, 2, "--") == 0)
+            {
+                std::cerr << usage() << ">>> ERROR! Invalid option " << str << ".\n";
+                return EXIT_FAILURE;
+            }
+            else
+                opt.files.push_back(str);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << ">>> ERROR! Invalid value for " << str << ".\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (opt.files.empty())
+        opt.files = asset_files();
+
+    for (auto &f : opt.files)
+        bench_file(f, f);
+
+    std::string synthetic = write_synthetic();
+    if (synthetic.empty())
+        std::cerr << ">>> ERROR! Unable to write the synthetic boards.\n";
+    else
+    {
+        bench_file(synthetic, "synthetic");
+        unlink(synthetic.c_str());
+    }
+
+    // A board far past what the level files hold.
+    bench_level(generate_maze(1024, 1024, 1), "maze1024");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+#include "../include/bitboard.h"
+
+namespace
+{
+    //! Counts the bits set of a word, in a form compilers turn into a single instruction when they can.
+    size_t popcount(uint64_t x) {
+        x = x - (x >> 1 & 0x5555555555555555ull);
+        x = (x & 0x3333333333333333ull) + (x >> 2 & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return (x * 0x0101010101010101ull) >> 56;
+    }
+
+    /**
+     * @brief Spread the cells of a word along the runs of open cells that hold them.
+     *
+     * Kogge-Stone fill: after the step of size k a cell is reached if it is open
+     * and a cell up to 2k - 1 steps away is, with the cells between open.
+     *
+     * @param seed The cells to spread, all of them open.
+     * @param open The open cells.
+     * @return The open cells connected to a seed within the word.
+     */
+    uint64_t fill_word(const uint64_t seed, const uint64_t open) {
+        uint64_t up = seed, up_open = open;
+        uint64_t down = seed, down_open = open;
+
+        for (int k = 1; k < 64; k *= 2) {
+            up |= up_open & (up << k);
+            up_open &= up_open << k;
+            down |= down_open & (down >> k);
+            down_open &= down_open >> k;
+        }
+        return up | down;
+    }
+}
+
+void BitBoard::resize(const size_t rows, const size_t cols) {
+    n_rows = rows;
+    n_cols = cols;
+    words = (cols + 63) / 64;
+    bits.assign(rows * words, 0);
+}
+
+size_t BitBoard::count() const {
+    size_t n = 0;
+    for (uint64_t word : bits)
+        n += popcount(word);
+    return n;
+}
+
+void BitBoard::assign_and_not(const BitBoard &a, const BitBoard &b) {
+    if (n_rows != a.n_rows || n_cols != a.n_cols) resize(a.n_rows, a.n_cols);
+
+    // A flat loop over whole rows, which compilers vectorize.
+    const uint64_t *pa = a.bits.data(), *pb = b.bits.data();
+    uint64_t *out = bits.data();
+    for (size_t i = 0; i < bits.size(); ++i)
+        out[i] = pa[i] & ~pb[i];
+}
+
+void BitBoard::wake(const BitBoard &open, const size_t w, const uint64_t gained) {
+    size_t row = w / words, col = w % words;
+
+    // Only the words with an open cell next to a gained one can gain anything.
+    size_t next[4];
+    int n = 0;
+    if (row > 0 && (gained & open.bits[w - words] & ~bits[w - words])) next[n++] = w - words;
+    if (row + 1 < n_rows && (gained & open.bits[w + words] & ~bits[w + words])) next[n++] = w + words;
+    if (col > 0 && (gained & 1) && (open.bits[w - 1] & ~bits[w - 1]) >> 63) next[n++] = w - 1;
+    if (col + 1 < words && (gained >> 63) && (open.bits[w + 1] & ~bits[w + 1] & 1)) next[n++] = w + 1;
+
+    for (int i = 0; i < n; ++i) {
+        if (queued[next[i]]) continue;
+        queued[next[i]] = 1;
+        work.push_back(next[i]);
+    }
+}
+
+size_t BitBoard::flood_fill(const BitBoard &open, const size_t row, const size_t col) {
+    resize(open.n_rows, open.n_cols);
+    if (row >= n_rows || col >= n_cols || !open.test(row, col)) return 0;
+
+    queued.assign(bits.size(), 0);
+    work.clear();
+
+    size_t start = row * words + col / 64;
+    bits[start] = fill_word(uint64_t(1) << (col % 64), open.bits[start]);
+    wake(open, start, bits[start]);
+
+    while (!work.empty()) {
+        size_t w = work.back();
+        work.pop_back();
+        queued[w] = 0;
+
+        // The cells of the word next to a filled one, in this row or the rows around it.
+        uint64_t seed = bits[w];
+        if (w >= words) seed |= bits[w - words];
+        if (w + words < bits.size()) seed |= bits[w + words];
+        if (w % words > 0) seed |= bits[w - 1] >> 63;
+        if (w % words + 1 < words) seed |= bits[w + 1] << 63;
+
+        uint64_t filled = fill_word(seed & open.bits[w], open.bits[w]);
+        uint64_t gained = filled & ~bits[w];
+        if (!gained) continue;
+
+        bits[w] = filled;
+        wake(open, w, gained);
+    }
+
+    return count();
+}
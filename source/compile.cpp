@@ -0,0 +1,43 @@
+/**!
+ *  This program compiles Snaze level files into the precompiled binary format.
+ *
+ *  The levels are parsed and validated once here, so the game can load the
+ *  result with a few copies per level instead of reading every character.
+ *
+ *  To compile: use cmake script.
+ */
+
+#include <cstdlib> // EXIT_SUCCESS
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../include/level_loader.h"
+
+int main(int argc, char *argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: snaze-compile <input_level_file> <output.snzb>\n";
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Level> levels;
+
+  try
+  {
+    load_levels(argv[1], levels);
+    if (levels.empty())
+      throw std::runtime_error("No levels found in file.");
+    save_levels(argv[2], levels);
+  }
+  catch (std::exception &e)
+  {
+    std::cerr << ">>> ERROR! " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  std::cout << ">>> OK! " << levels.size() << " level(s) written to " << argv[2] << ".\n";
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+#include "../include/cycle.h"
+
+#include <algorithm>
+
+const uint32_t HamiltonianCycle::NO_CELL;
+
+bool HamiltonianCycle::build(Level &level) {
+    length = 0;
+    stride = level.get_stride();
+    next.assign(level.get_cells(), NO_CELL);
+    order.assign(level.get_cells(), 0);
+
+    uint32_t spawn = level.cell_index(level.get_spawn());
+
+    // The reachable cells, their bounding box and how many fall on each color
+    // of the checkerboard. A cycle on a grid alternates colors, so it needs as
+    // many cells of each.
+    std::vector<uint8_t> in_component(level.get_cells(), 0);
+    size_t n = 0, black = 0;
+    size_t top = SIZE_MAX, bottom = 0, left = SIZE_MAX, right = 0;
+
+    for (size_t r{0}; r < level.get_rows(); ++r)
+        for (size_t c{0}; c < level.get_cols(); ++c) {
+            uint32_t cell = level.cell_index({r, c});
+            if (!level.reachable(cell)) continue;
+
+            in_component[cell] = 1;
+            ++n;
+            black += (r + c) & 1;
+            top = std::min(top, r);
+            bottom = std::max(bottom, r);
+            left = std::min(left, c);
+            right = std::max(right, c);
+        }
+
+    if (n < 4 || 2 * black != n) return false;
+
+    size_t rows = bottom - top + 1, cols = right - left + 1;
+    bool built = rows * cols == n ? build_sweep(level, {top, left}, rows, cols) : build_blocks(level, in_component);
+
+    if (!built || !number_cells(spawn, n)) {
+        next.assign(next.size(), NO_CELL);
+        return false;
+    }
+
+    length = n;
+    return true;
+}
+
+bool HamiltonianCycle::build_sweep(Level &level, const TilePos top_left, const size_t rows, const size_t cols) {
+    if (rows < 2 || cols < 2 || (rows & 1 && cols & 1)) return false;
+
+    // Sweep the rows when there is an even number of them, otherwise the columns.
+    bool by_rows = !(rows & 1);
+    size_t lines = by_rows ? rows : cols;
+    size_t span = by_rows ? cols : rows;
+
+    auto cell = [&](size_t line, size_t k) {
+        return level.cell_index(by_rows ? TilePos{top_left.row + line, top_left.col + k}
+                                        : TilePos{top_left.row + k, top_left.col + line});
+    };
+
+    // The first line goes all the way; the others zigzag over k >= 1 and the
+    // last one ends next to k = 0, which leads back to the start.
+    for (size_t k{0}; k + 1 < span; ++k) next[cell(0, k)] = cell(0, k + 1);
+    next[cell(0, span - 1)] = cell(1, span - 1);
+
+    for (size_t line{1}; line < lines; ++line) {
+        bool backwards = line & 1;
+        for (size_t k{1}; k + 1 < span; ++k) {
+            if (backwards) next[cell(line, span - k)] = cell(line, span - k - 1);
+            else next[cell(line, k)] = cell(line, k + 1);
+        }
+
+        uint32_t end = backwards ? cell(line, 1) : cell(line, span - 1);
+        next[end] = line + 1 < lines ? cell(line + 1, backwards ? 1 : span - 1) : cell(line, 0);
+    }
+
+    for (size_t line{lines - 1}; line > 0; --line) next[cell(line, 0)] = cell(line - 1, 0);
+
+    return true;
+}
+
+bool HamiltonianCycle::build_blocks(Level &level, const std::vector<uint8_t> &in_component) {
+    size_t rows = level.get_rows(), cols = level.get_cols();
+    std::vector<uint8_t> is_block(level.get_cells(), 0);
+
+    for (size_t dr{0}; dr < 2; ++dr)
+        for (size_t dc{0}; dc < 2; ++dc) {
+            // Blocks start at rows = dr and columns = dc modulo 2 (row -1 wraps
+            // around as size_t and lands on the border, as in cell_index).
+            bool fits = true;
+            std::fill(is_block.begin(), is_block.end(), 0);
+
+            for (size_t r{0}; r < rows && fits; ++r)
+                for (size_t c{0}; c < cols && fits; ++c) {
+                    if (!in_component[level.cell_index({r, c})]) continue;
+
+                    uint32_t tl = level.cell_index({r - ((r + dr) & 1), c - ((c + dc) & 1)});
+                    fits = in_component[tl] && in_component[tl + 1] && in_component[tl + stride] &&
+                           in_component[tl + stride + 1];
+                    if (fits) is_block[tl] = 1;
+                }
+
+            if (!fits) continue;
+
+            // Every block starts as its own clockwise loop.
+            uint32_t root = 0;
+            for (uint32_t tl{0}; tl < is_block.size(); ++tl) {
+                if (!is_block[tl]) continue;
+                next[tl] = tl + 1;
+                next[tl + 1] = tl + stride + 1;
+                next[tl + stride + 1] = tl + stride;
+                next[tl + stride] = tl;
+                root = tl;
+            }
+
+            // Join the loops along a spanning tree of the blocks. Two blocks side
+            // by side trade their facing edges for two edges across; each side of
+            // a block is crossed at most once, so the joins don't interfere.
+            std::vector<uint32_t> queue{root};
+            is_block[root] = 2;
+
+            for (size_t i{0}; i < queue.size(); ++i) {
+                uint32_t a = queue[i];
+                const uint32_t neighbors[4] = {a + 2, a - 2, a + 2 * static_cast<uint32_t>(stride),
+                                               a - 2 * static_cast<uint32_t>(stride)};
+
+                for (unsigned k{0}; k < 4; ++k) {
+                    uint32_t b = neighbors[k];
+                    if (b >= is_block.size() || is_block[b] != 1) continue;
+
+                    is_block[b] = 2;
+                    queue.push_back(b);
+
+                    // Left and upper block of the pair.
+                    uint32_t first = (k & 1) ? b : a, second = (k & 1) ? a : b;
+                    if (k < 2) {
+                        next[first + 1] = second;
+                        next[second + stride] = first + stride + 1;
+                    } else {
+                        next[first + stride + 1] = second + 1;
+                        next[second] = first + stride;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+    return false;
+}
+
+bool HamiltonianCycle::number_cells(const uint32_t start, const size_t n) {
+    uint32_t cell = start;
+
+    for (size_t i{0}; i < n; ++i) {
+        if (next[cell] == NO_CELL || (i > 0 && cell == start)) return false;
+        order[cell] = i;
+        cell = next[cell];
+    }
+
+    return cell == start;
+}
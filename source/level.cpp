@@ -1,7 +1,13 @@
 #include "../include/level.h"
 
+#include <algorithm>
 #include <iostream>
 
+const uint32_t Level::NOT_FREE;
+const size_t Level::MAX_SIZE;
+const size_t Level::FIELD_CACHE_BYTES;
+const int Level::MAX_PELLET_DRAWS;
+
 void Level::set_cols(const int cols) {
     n_cols = cols;
 }
@@ -14,22 +20,132 @@ void Level::set_spawn(const TilePos spawn) {
 }
 
 void Level::add_line(std::string line) {
-    board.push_back(line);
+    add_row(line.data(), line.size());
+}
+
+size_t Level::add_row(const char *data, const size_t len) {
+    if (grid.empty()) {
+        stride = n_cols + 2;
+        grid.assign((n_rows + 2) * stride, tile_type_e::WALL);
+        free_slot.assign(grid.size(), NOT_FREE);
+    }
+
+    size_t row = loaded_rows++;
+    size_t cols = n_cols;
+    size_t invalid = len;
+    bool spawn_found = false;
+
+    // One pass: validate, translate and look for the spawn location.
+    for (size_t j{0}; j < len; ++j) {
+        tile_type_e type;
+        switch (data[j]) {
+        case ' ': type = tile_type_e::EMPTY; break;
+        case '#': type = tile_type_e::WALL; break;
+        case '.': type = tile_type_e::INVISIBLE; break;
+        case '*':
+            type = tile_type_e::SNAKEHEAD;
+            if (!spawn_found && j < cols) {
+                set_spawn({row, j});
+                spawn_found = has_spawn = true;
+            }
+            break;
+        default:
+            type = tile_type_e::EMPTY;
+            if (invalid == len) invalid = j;
+        }
+
+        if (j < cols) {
+            size_t cell = cell_index({row, j});
+            grid[cell] = type;
+            if (type == tile_type_e::EMPTY) add_free(cell);
+            if (type != tile_type_e::WALL && type != tile_type_e::INVISIBLE) ++n_walkable;
+        }
+    }
+
+    // Missing columns are empty spaces.
+    for (size_t j{len}; j < cols; ++j) {
+        size_t cell = cell_index({row, j});
+        grid[cell] = tile_type_e::EMPTY;
+        add_free(cell);
+        ++n_walkable;
+    }
+
+    return invalid;
+}
+
+void Level::load_packed(const uint8_t *cells, const uint32_t *free, const size_t n_free, const size_t walkable) {
+    stride = n_cols + 2;
+    grid.assign(cells, cells + (n_rows + 2) * stride);
+    free_cells.assign(free, free + n_free);
+    free_slot.assign(grid.size(), NOT_FREE);
+    for (size_t i{0}; i < n_free; ++i) free_slot[free_cells[i]] = i;
+
+    loaded_rows = n_rows;
+    n_walkable = walkable;
+    has_spawn = true;
+}
+
+void Level::copy_layout(const Level &l) {
+    n_rows = l.n_rows;
+    n_cols = l.n_cols;
+    snake_spawn_loc = l.snake_spawn_loc;
+    pellet_loc = l.pellet_loc;
+    load_packed(l.grid.data(), l.free_cells.data(), l.free_cells.size(), l.n_walkable);
+
+    fields.clear();
+    field_slot.clear();
+    field_clock = 0;
+    spawn_reach = BitBoard();
+    open_bits = BitBoard();
+    snake_bits = BitBoard();
+}
+
+bool Level::get_has_spawn() {
+    return has_spawn;
+}
+
+void Level::add_free(const uint32_t cell) {
+    free_slot[cell] = free_cells.size();
+    free_cells.push_back(cell);
+}
+
+void Level::remove_free(const uint32_t cell) {
+    uint32_t slot = free_slot[cell];
+    uint32_t last = free_cells.back();
+
+    free_cells[slot] = last;
+    free_slot[last] = slot;
+    free_cells.pop_back();
+    free_slot[cell] = NOT_FREE;
 }
 
 void Level::set_tile_type(const TilePos pos, const tile_type_e type) {
-    board[pos.row][pos.col] = tile_type[type];
+    size_t cell = cell_index(pos);
+
+    if (grid[cell] == tile_type_e::EMPTY && type != tile_type_e::EMPTY) remove_free(cell);
+    else if (grid[cell] != tile_type_e::EMPTY && type == tile_type_e::EMPTY) add_free(cell);
+
+    grid[cell] = type;
+
+    if (!snake_bits.empty()) {
+        if (type == tile_type_e::SNAKEHEAD || type == tile_type_e::SNAKEBODY) snake_bits.set(pos.row, pos.col);
+        else snake_bits.reset(pos.row, pos.col);
+    }
 }
 
-size_t Level::get_cols() {
+size_t Level::get_cols() const {
     return n_cols;
 }
 
-size_t Level::get_rows() {
+size_t Level::get_rows() const {
     return n_rows;
 }
 
-TilePos Level::get_spawn() {
+size_t Level::get_walkable() const {
+    return n_walkable;
+}
+
+TilePos Level::get_spawn() const {
     return snake_spawn_loc;
 }
 TilePos Level::get_pellet_loc() {
@@ -37,47 +153,157 @@ TilePos Level::get_pellet_loc() {
 }
         
 
-tile_type_e Level::get_tile_type(const TilePos pos) {
-    size_t aux = tile_type.find(board[pos.row][pos.col]);
-    return static_cast<tile_type_e>(aux);
-}
-
 std::vector<TilePos> Level::empty_spaces() {
     std::vector<TilePos> aux;
-     for(size_t i{0}; i < n_rows; ++i){
-        for(size_t j{0}; j < n_cols; ++j) {
-            if(board[i][j] == ' ') aux.push_back({i, j});
+    aux.reserve(free_cells.size());
+
+    for (uint32_t cell : free_cells)
+        aux.push_back(cell_pos(cell));
+
+    return aux;
+}
+
+
+const uint32_t *Level::distance_field(const uint32_t goal) {
+    ++field_clock;
+
+    auto found = field_slot.find(goal);
+    if (found != field_slot.end()) {
+        fields[found->second].last_used = field_clock;
+        return fields[found->second].dist.data();
+    }
+
+    size_t capacity = std::max<size_t>(1, FIELD_CACHE_BYTES / (grid.size() * sizeof(uint32_t)));
+    uint32_t slot;
+
+    if (fields.size() < capacity) {
+        slot = fields.size();
+        fields.emplace_back();
+    } else {
+        // Evict the least recently used field and reuse its memory.
+        slot = 0;
+        for (uint32_t i{1}; i < fields.size(); ++i)
+            if (fields[i].last_used < fields[slot].last_used) slot = i;
+        field_slot.erase(fields[slot].goal);
+    }
+
+    DistanceField &field = fields[slot];
+    field.goal = goal;
+    field.last_used = field_clock;
+    compute_field(field);
+    field_slot[goal] = slot;
+
+    return field.dist.data();
+}
+
+void Level::compute_field(DistanceField &field) {
+    field.dist.assign(grid.size(), UINT32_MAX);
+    if (grid[field.goal] == tile_type_e::WALL || grid[field.goal] == tile_type_e::INVISIBLE) return;
+
+    const long offset[4] = {static_cast<long>(stride), -static_cast<long>(stride), -1, 1};
+
+    // The border of walls keeps the search inside the board.
+    field_queue.clear();
+    field_queue.push_back(field.goal);
+    field.dist[field.goal] = 0;
+
+    for (size_t i{0}; i < field_queue.size(); ++i) {
+        uint32_t cell = field_queue[i];
+
+        for (long step : offset) {
+            uint32_t next = cell + step;
+            if (field.dist[next] != UINT32_MAX || grid[next] == tile_type_e::WALL || grid[next] == tile_type_e::INVISIBLE)
+                continue;
+
+            field.dist[next] = field.dist[cell] + 1;
+            field_queue.push_back(next);
         }
     }
+}
 
-    return aux;
+void Level::build_bits() {
+    open_bits.resize(n_rows, n_cols);
+    snake_bits.resize(n_rows, n_cols);
+
+    for (size_t row{0}; row < size_t(n_rows); ++row)
+        for (size_t col{0}; col < size_t(n_cols); ++col) {
+            tile_type_e type = get_tile_type({row, col});
+            if (type != tile_type_e::WALL && type != tile_type_e::INVISIBLE) open_bits.set(row, col);
+            if (type == tile_type_e::SNAKEHEAD || type == tile_type_e::SNAKEBODY) snake_bits.set(row, col);
+        }
+}
+
+void Level::compute_reach() {
+    if (open_bits.empty()) build_bits();
+    spawn_reach.flood_fill(open_bits, snake_spawn_loc.row, snake_spawn_loc.col);
+}
+
+size_t Level::region_size(const TilePos from) {
+    if (open_bits.empty()) build_bits();
+    if (from.row >= size_t(n_rows) || from.col >= size_t(n_cols) || !open_bits.test(from.row, from.col)) return 0;
+
+    region_open.assign_and_not(open_bits, snake_bits);
+    region_open.set(from.row, from.col);
+    return region.flood_fill(region_open, from.row, from.col);
 }
 
+bool Level::place_pellet(std::mt19937 &gen) {
+    size_t candidates = free_cells.size();
 
-void Level::place_pellet() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::vector<TilePos> es = empty_spaces();
+    // Park the spawn location in the last slot and leave it out of the draw.
+    uint32_t spawn = cell_index(snake_spawn_loc);
+    if (free_slot[spawn] != NOT_FREE) {
+        uint32_t slot = free_slot[spawn];
+        uint32_t last = free_cells.back();
 
-    std::uniform_int_distribution<> random_index(0, es.size() - 1);
+        free_cells[slot] = last;
+        free_slot[last] = slot;
+        free_cells.back() = spawn;
+        free_slot[spawn] = candidates - 1;
+        --candidates;
+    }
+
+    if (candidates == 0) return false;
+
+    std::uniform_int_distribution<size_t> random_index(0, candidates - 1);
+    uint32_t cell = free_cells[random_index(gen)];
+
+    for (int draws = 1; !reachable(cell); ++draws) {
+        if (draws < MAX_PELLET_DRAWS) {
+            cell = free_cells[random_index(gen)];
+            continue;
+        }
 
-    pellet_loc = es[random_index(gen)];
+        // Mostly walled off: pick among the reachable cells directly.
+        std::vector<uint32_t> reachable_cells;
+        for (size_t i{0}; i < candidates; ++i)
+            if (reachable(free_cells[i])) reachable_cells.push_back(free_cells[i]);
+        if (reachable_cells.empty()) return false;
+
+        std::uniform_int_distribution<size_t> reachable_index(0, reachable_cells.size() - 1);
+        cell = reachable_cells[reachable_index(gen)];
+    }
+
+    pellet_loc = cell_pos(cell);
+    set_tile_type(pellet_loc, tile_type_e::FOOD);
+    return true;
+}
 
-    while(pellet_loc == snake_spawn_loc) 
-        pellet_loc = es[random_index(gen)];
+bool Level::place_pellet_at(const TilePos pos) {
+    if (pos.row >= get_rows() || pos.col >= get_cols() || get_tile_type(pos) != tile_type_e::EMPTY) return false;
 
-    board[pellet_loc.row][pellet_loc.col] = '@';
+    pellet_loc = pos;
+    set_tile_type(pellet_loc, tile_type_e::FOOD);
+    return true;
 }
 
 bool Level::crashed(const TilePos pos) {
-    return (board[pos.row][pos.col] == '.' || board[pos.row][pos.col] == '#' || board[pos.row][pos.col] == 'o');
+    tile_type_e type = get_tile_type(pos);
+    return (type == tile_type_e::INVISIBLE || type == tile_type_e::WALL || type == tile_type_e::SNAKEBODY);
 }
 
 bool Level::is_food(const TilePos pos) {
-    if (board[pos.row][pos.col] == '@') 
-        return true;
-    
-    return false;
+    return get_tile_type(pos) == tile_type_e::FOOD;
 }
 
 
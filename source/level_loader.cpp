@@ -0,0 +1,304 @@
+#include "../include/level_loader.h"
+#include "../include/byte_io.h"
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    //! Largest number of rows or columns of a level.
+    const long MAX_SIZE = Level::MAX_SIZE;
+
+    /**
+     * @brief A read-only memory mapping of a whole file, unmapped on destruction.
+     */
+    class MappedFile
+    {
+    private:
+        const char *data = nullptr; //!< The first byte of the file.
+        size_t size = 0;            //!< The size of the file.
+
+    public:
+        explicit MappedFile(const std::string &path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Unable to open level file.\n");
+
+            struct stat st;
+            if (::fstat(fd, &st) < 0) {
+                ::close(fd);
+                throw std::runtime_error("Unable to open level file.\n");
+            }
+
+            size = static_cast<size_t>(st.st_size);
+            if (size > 0) {
+                void *p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::runtime_error("Unable to map level file.\n");
+                }
+                ::madvise(p, size, MADV_SEQUENTIAL);
+                data = static_cast<const char *>(p);
+            }
+            ::close(fd);
+        }
+
+        ~MappedFile() {
+            if (data) ::munmap(const_cast<char *>(data), size);
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *begin() const { return data; }
+        const char *end() const { return data + size; }
+    };
+
+    /**
+     * @brief Walks the lines of a buffer, keeping track of the line number.
+     */
+    struct LineCursor
+    {
+        const char *pos;   //!< The start of the next line.
+        const char *end;   //!< The end of the buffer.
+        size_t number = 0; //!< The 1-based number of the last line read.
+
+        LineCursor(const char *b, const char *e) : pos(b), end(e) {}
+
+        /**
+         * @brief Read the next line, without its line break or trailing '\r'.
+         * @return False if there are no more lines.
+         */
+        bool next(const char *&line, size_t &len) {
+            if (pos == end) return false;
+
+            const char *nl = static_cast<const char *>(std::memchr(pos, '\n', end - pos));
+            const char *stop = nl ? nl : end;
+
+            line = pos;
+            len = stop - pos;
+            while (len > 0 && line[len - 1] == '\r') --len;
+
+            pos = nl ? nl + 1 : end;
+            ++number;
+            return true;
+        }
+    };
+
+    std::string where(size_t line, size_t col) {
+        return " (line " + std::to_string(line) + ", column " + std::to_string(col) + ")\n";
+    }
+
+    bool is_blank(const char *line, size_t len) {
+        for (size_t i{0}; i < len; ++i)
+            if (line[i] != ' ' && line[i] != '\t') return false;
+        return true;
+    }
+
+    /**
+     * @brief Parse a number in [1,MAX_SIZE], skipping leading blanks.
+     * @return The number, or -1 if there is none or it's out of range; i is then left at its start.
+     */
+    long parse_size(const char *line, size_t len, size_t &i) {
+        while (i < len && (line[i] == ' ' || line[i] == '\t')) ++i;
+        if (i == len || line[i] < '0' || line[i] > '9') return -1;
+
+        size_t start = i;
+        long value = 0;
+        while (i < len && line[i] >= '0' && line[i] <= '9') {
+            value = value * 10 + (line[i] - '0');
+            if (value > MAX_SIZE) break;
+            ++i;
+        }
+        if (value < 1 || value > MAX_SIZE) {
+            i = start;
+            return -1;
+        }
+        return value;
+    }
+
+    const char MAGIC[4] = {'S', 'N', 'Z', 'B'}; //!< First bytes of a precompiled level file.
+    const uint32_t VERSION = 1;                 //!< Version of the precompiled format.
+
+    /**
+     * @brief Reads the little-endian integers of a precompiled level file, checking bounds.
+     */
+    struct PackedReader
+    {
+        const char *pos; //!< The next byte to be read.
+        const char *end; //!< The end of the file.
+
+        PackedReader(const char *b, const char *e) : pos(b), end(e) {}
+
+        const char *take(size_t n) {
+            if (static_cast<size_t>(end - pos) < n)
+                throw std::runtime_error("The precompiled level file is truncated.\n");
+            const char *p = pos;
+            pos += n;
+            return p;
+        }
+
+        uint32_t u32() { return get_u32(reinterpret_cast<const uint8_t *>(take(4))); }
+    };
+
+    std::runtime_error corrupted(const uint32_t l) {
+        return std::runtime_error("Level " + std::to_string(l + 1) + " of the precompiled level file is corrupted.\n");
+    }
+
+    /**
+     * @brief Check the grid of a precompiled level before it is trusted.
+     *
+     * The planners step to neighbours without bounds checks, relying on the
+     * border of walls, so it must be whole; the tiles must be tile types and
+     * agree with the counts of the header.
+     */
+    void check_packed_grid(const uint8_t *cells, const uint32_t r, const uint32_t c, const uint32_t walkable,
+                           const uint32_t n_free, const uint32_t l) {
+        size_t stride = c + 2;
+        for (size_t j{0}; j < stride; ++j)
+            if (cells[j] != tile_type_e::WALL || cells[(r + 1) * stride + j] != tile_type_e::WALL) throw corrupted(l);
+
+        size_t n_walkable = 0, n_empty = 0;
+        for (size_t row{1}; row <= r; ++row) {
+            const uint8_t *line = cells + row * stride;
+            if (line[0] != tile_type_e::WALL || line[c + 1] != tile_type_e::WALL) throw corrupted(l);
+
+            for (size_t j{1}; j <= c; ++j) {
+                if (line[j] > tile_type_e::SNAKEBODY) throw corrupted(l);
+                if (line[j] != tile_type_e::WALL && line[j] != tile_type_e::INVISIBLE) ++n_walkable;
+                if (line[j] == tile_type_e::EMPTY) ++n_empty;
+            }
+        }
+
+        if (n_walkable != walkable || n_empty != n_free) throw corrupted(l);
+    }
+
+    void load_packed_levels(const char *begin, const char *end, std::vector<Level> &levels) {
+        PackedReader in(begin, end);
+        in.take(sizeof(MAGIC));
+
+        if (in.u32() != VERSION)
+            throw std::runtime_error("Unsupported version of the precompiled level file.\n");
+
+        uint32_t n_levels = in.u32();
+        std::vector<uint32_t> free;
+        std::vector<uint8_t> listed;
+
+        for (uint32_t l{0}; l < n_levels; ++l) {
+            uint32_t r = in.u32(), c = in.u32();
+            uint32_t spawn_row = in.u32(), spawn_col = in.u32();
+            uint32_t walkable = in.u32(), n_free = in.u32();
+
+            if (r < 1 || c < 1 || r > MAX_SIZE || c > MAX_SIZE || spawn_row >= r || spawn_col >= c)
+                throw corrupted(l);
+
+            size_t n_cells = (size_t(r) + 2) * (size_t(c) + 2);
+            const uint8_t *cells = reinterpret_cast<const uint8_t *>(in.take(n_cells));
+
+            if (n_free > n_cells)
+                throw corrupted(l);
+            check_packed_grid(cells, r, c, walkable, n_free, l);
+
+            uint8_t spawn_type = cells[(size_t(spawn_row) + 1) * (c + 2) + spawn_col + 1];
+            if (spawn_type == tile_type_e::WALL || spawn_type == tile_type_e::INVISIBLE)
+                throw corrupted(l);
+
+            const uint8_t *raw = reinterpret_cast<const uint8_t *>(in.take(4 * size_t(n_free)));
+
+            // As many empty cells as entries, each listed once: the list is exactly the empty cells.
+            listed.assign(n_cells, 0);
+            free.resize(n_free);
+            for (uint32_t i{0}; i < n_free; ++i) {
+                free[i] = get_u32(raw + 4 * i);
+                if (free[i] >= n_cells || cells[free[i]] != tile_type_e::EMPTY || listed[free[i]])
+                    throw corrupted(l);
+                listed[free[i]] = 1;
+            }
+
+            levels.emplace_back();
+            Level &level = levels.back();
+            level.set_rows(r);
+            level.set_cols(c);
+            level.set_spawn({spawn_row, spawn_col});
+            level.load_packed(cells, free.data(), n_free, walkable);
+        }
+    }
+}
+
+void load_levels(const std::string &path, std::vector<Level> &levels) {
+    MappedFile file(path);
+
+    if (file.end() - file.begin() >= static_cast<long>(sizeof(MAGIC))
+        && std::memcmp(file.begin(), MAGIC, sizeof(MAGIC)) == 0) {
+        load_packed_levels(file.begin(), file.end(), levels);
+        return;
+    }
+
+    LineCursor cursor(file.begin(), file.end());
+
+    const char *line;
+    size_t len;
+
+    while (cursor.next(line, len)) {
+        if (is_blank(line, len)) continue;
+
+        // Anything after the number of columns is ignored, as it always was.
+        size_t i = 0;
+        long r = parse_size(line, len, i);
+        long c = r < 0 ? -1 : parse_size(line, len, i);
+        if (r < 0 || c < 0)
+            throw std::runtime_error("The values for number of rows and columns is invalid. Valid range is [1," + std::to_string(MAX_SIZE) + "]"
+                                     + where(cursor.number, i + 1));
+
+        levels.emplace_back();
+        Level &level = levels.back();
+        level.set_rows(r);
+        level.set_cols(c);
+
+        for (long row{0}; row < r; ++row) {
+            if (!cursor.next(line, len))
+                throw std::runtime_error("The level ends before all of its " + std::to_string(r) + " rows were read"
+                                         + where(cursor.number + 1, 1));
+
+            size_t bad = level.add_row(line, len);
+            if (bad != len)
+                throw std::runtime_error("The file could not be read. It shows unexpected symbols"
+                                         + where(cursor.number, bad + 1));
+        }
+
+        if (!level.get_has_spawn())
+            levels.pop_back();
+    }
+}
+
+void save_levels(const std::string &path, const std::vector<Level> &levels) {
+    std::string out(MAGIC, sizeof(MAGIC));
+    put_u32(out, VERSION);
+    put_u32(out, levels.size());
+
+    for (const Level &level : levels) {
+        put_u32(out, level.get_rows());
+        put_u32(out, level.get_cols());
+        put_u32(out, level.get_spawn().row);
+        put_u32(out, level.get_spawn().col);
+        put_u32(out, level.get_walkable());
+        put_u32(out, level.get_free_cells().size());
+
+        out.append(level.get_grid().begin(), level.get_grid().end());
+        for (uint32_t cell : level.get_free_cells()) put_u32(out, cell);
+    }
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        throw std::runtime_error("Unable to open output file.\n");
+
+    bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error("Unable to write output file.\n");
+}
@@ -29,7 +29,9 @@ int main(int argc, char *argv[])
     simulation.process_events();
     simulation.update();
     simulation.render();
+    // Fixed timestep: sleep until the next absolute deadline.
+    simulation.wait_next_tick();
   }
 
-  return EXIT_SUCCESS;
+  return simulation.replay_failed() ? EXIT_FAILURE : EXIT_SUCCESS;
 }
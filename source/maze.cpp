@@ -0,0 +1,71 @@
+#include "../include/maze.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+    //! Chance of knocking down each wall left between two rooms.
+    const double LOOP_CHANCE = 0.1;
+}
+
+Level generate_maze(const size_t rows, const size_t cols, const uint64_t seed) {
+    // Both halves of the seed, so seeds 2^32 apart make different mazes.
+    std::seed_seq seq{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+    std::mt19937 rng(seq);
+    std::vector<char> cells(rows * cols, '#');
+
+    // Rooms sit on even rows and columns; the cells between two rooms are
+    // the walls that get carved.
+    const size_t room_rows = (rows + 1) / 2, room_cols = (cols + 1) / 2;
+    const long step[4][2] = {{0, 1}, {0, -1}, {-1, 0}, {1, 0}};
+
+    std::vector<uint32_t> stack;
+    stack.push_back(0);
+    cells[0] = ' ';
+
+    while (!stack.empty()) {
+        uint32_t room = stack.back();
+        size_t rr = room / room_cols, rc = room % room_cols;
+
+        // Rooms next to this one that weren't carved yet.
+        unsigned open[4];
+        unsigned n_open = 0;
+        for (unsigned k{0}; k < 4; ++k) {
+            size_t nr = rr + step[k][0], nc = rc + step[k][1];
+            if (nr < room_rows && nc < room_cols && cells[2 * nr * cols + 2 * nc] == '#')
+                open[n_open++] = k;
+        }
+
+        if (n_open == 0) {
+            stack.pop_back();
+            continue;
+        }
+
+        unsigned k = open[std::uniform_int_distribution<unsigned>(0, n_open - 1)(rng)];
+        size_t nr = rr + step[k][0], nc = rc + step[k][1];
+
+        cells[(rr + nr) * cols + rc + nc] = ' ';
+        cells[2 * nr * cols + 2 * nc] = ' ';
+        stack.push_back(nr * room_cols + nc);
+    }
+
+    std::bernoulli_distribution loop(LOOP_CHANCE);
+    for (size_t r{0}; r < rows; ++r)
+        for (size_t c{0}; c < cols; ++c) {
+            bool between_rows = (r & 1) && !(c & 1) && r + 1 < rows;
+            bool between_cols = !(r & 1) && (c & 1) && c + 1 < cols;
+            if ((between_rows || between_cols) && cells[r * cols + c] == '#' && loop(rng))
+                cells[r * cols + c] = ' ';
+        }
+
+    cells[0] = '*';
+
+    Level level;
+    level.set_rows(rows);
+    level.set_cols(cols);
+    for (size_t r{0}; r < rows; ++r)
+        level.add_row(&cells[r * cols], cols);
+
+    return level;
+}
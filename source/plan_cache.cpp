@@ -0,0 +1,170 @@
+#include "../include/plan_cache.h"
+#include "../include/byte_io.h"
+#include "../include/move_code.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+const size_t PlanCache::MAX_BODY;
+const size_t PlanCache::MAX_MOVES;
+
+namespace
+{
+    const char MAGIC[4] = {'S', 'N', 'Z', 'P'};
+    const uint32_t VERSION = 1;
+
+    /**
+     * @brief Reads little-endian integers from a buffer, throwing past its end.
+     */
+    class Input {
+    private:
+        const std::vector<uint8_t> &data; //!< The file.
+        size_t pos = 0;                   //!< The next byte to be read.
+
+    public:
+        explicit Input(const std::vector<uint8_t> &d) : data(d) {}
+
+        bool at_end() const { return pos == data.size(); }
+
+        void need(const size_t n) const {
+            if (data.size() - pos < n) throw std::runtime_error("plan cache file is truncated");
+        }
+
+        uint8_t u8() {
+            need(1);
+            return data[pos++];
+        }
+
+        uint32_t u32() { return get_u32(bytes(4)); }
+
+        uint64_t u64() { return get_u64(bytes(8)); }
+
+        const uint8_t *bytes(const size_t n) {
+            need(n);
+            pos += n;
+            return data.data() + pos - n;
+        }
+    };
+}
+
+void PlanCache::set_capacity(const size_t n) {
+    capacity = n;
+    while (entries.size() > capacity) {
+        index.erase(entries.back().state.key);
+        entries.pop_back();
+    }
+}
+
+bool PlanCache::lookup(const PlanState &state, std::vector<MoveDir> &moves) {
+    auto found = index.find(state.key);
+    if (found == index.end()) return false;
+
+    // Another state with the same key is a miss, not a wrong plan.
+    const PlanState &cached = found->second->state;
+    if (cached.level != state.level || cached.planner != state.planner || cached.dir != state.dir ||
+        cached.pellet != state.pellet || cached.body != state.body)
+        return false;
+
+    entries.splice(entries.begin(), entries, found->second);
+
+    const Entry &entry = entries.front();
+    moves.clear();
+    for (uint32_t i = 0; i < entry.n_moves; ++i)
+        moves.push_back(MOVE_CODES[entry.moves[i / 4] >> (2 * (i % 4)) & 3]);
+    return true;
+}
+
+void PlanCache::insert(const PlanState &state, const std::vector<MoveDir> &moves) {
+    if (capacity == 0 || state.body.size() > MAX_BODY || moves.size() > MAX_MOVES) return;
+
+    auto found = index.find(state.key);
+    if (found != index.end()) {
+        entries.erase(found->second);
+        index.erase(found);
+    }
+
+    entries.push_front(Entry());
+    Entry &entry = entries.front();
+    entry.state = state;
+    entry.n_moves = moves.size();
+    entry.moves.assign((moves.size() + 3) / 4, 0);
+    for (size_t i = 0; i < moves.size(); ++i)
+        entry.moves[i / 4] |= move_code(moves[i]) << (2 * (i % 4));
+    index[state.key] = entries.begin();
+
+    set_capacity(capacity);
+}
+
+void PlanCache::load(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return; // nothing was cached yet
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    Input in(data);
+
+    const uint8_t *magic = in.bytes(sizeof(MAGIC));
+    if (!std::equal(MAGIC, MAGIC + sizeof(MAGIC), magic)) throw std::runtime_error("not a plan cache file");
+    if (in.u32() != VERSION) throw std::runtime_error("unsupported plan cache version");
+
+    uint32_t count = in.u32();
+    PlanState state;
+    std::vector<MoveDir> moves;
+    for (uint32_t e = 0; e < count; ++e) {
+        state.level = in.u64();
+        state.planner = in.u8();
+        state.dir = in.u8();
+        state.pellet.row = in.u32();
+        state.pellet.col = in.u32();
+
+        uint32_t length = in.u32();
+        if (length == 0 || length > MAX_BODY || state.dir > 4) throw std::runtime_error("corrupt plan cache entry");
+        state.body.resize(length);
+        uint64_t body_key = 0;
+        for (auto &pos : state.body) {
+            pos.row = in.u32();
+            pos.col = in.u32();
+            body_key ^= zobrist_key(pos);
+        }
+
+        uint32_t n_moves = in.u32();
+        if (n_moves > MAX_MOVES) throw std::runtime_error("corrupt plan cache entry");
+        const uint8_t *packed = in.bytes((n_moves + 3) / 4);
+        moves.clear();
+        for (uint32_t i = 0; i < n_moves; ++i)
+            moves.push_back(MOVE_CODES[packed[i / 4] >> (2 * (i % 4)) & 3]);
+
+        // The key isn't stored, so it always agrees with the state.
+        state.key = plan_key(state.level, state.planner, state.dir, state.pellet, state.body[0], body_key);
+        insert(state, moves);
+    }
+
+    if (!in.at_end()) throw std::runtime_error("trailing bytes in plan cache file");
+}
+
+bool PlanCache::save(const std::string &path) const {
+    std::string out(MAGIC, sizeof(MAGIC));
+    put_u32(out, VERSION);
+    put_u32(out, entries.size());
+
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+        const PlanState &state = it->state;
+        put_u64(out, state.level);
+        out += static_cast<char>(state.planner);
+        out += static_cast<char>(state.dir);
+        put_u32(out, state.pellet.row);
+        put_u32(out, state.pellet.col);
+        put_u32(out, state.body.size());
+        for (const auto &pos : state.body) {
+            put_u32(out, pos.row);
+            put_u32(out, pos.col);
+        }
+        put_u32(out, it->n_moves);
+        out.append(it->moves.begin(), it->moves.end());
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    return static_cast<bool>(file);
+}
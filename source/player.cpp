@@ -1,11 +1,11 @@
 #include <iostream>
 #include <random>
+#include <thread>
 #include <vector>
-#include <stack>
-#include <set>
-#include <queue>
+#include <algorithm>
 
 #include "../include/player.h"
+#include "../include/move_code.h"
 
 void Player::bind_level(Level *l)
 {
@@ -17,38 +17,48 @@ void Player::bind_snake(Snake *s)
   snake = s;
 }
 
+void Player::bind_rng(std::mt19937 *gen)
+{
+  rng = gen;
+}
+
 MoveDir Player::next_move_random() 
 {
   MoveDir dir = snake->get_dir();
-  std::vector<MoveDir> possible_dirs;
+  MoveDir possible_dirs[4];
+  int n_possible = 0;
 
   if (dir == MoveDir{0,0}) {
     // if direction is neutral (game start), all directions are possible 
-    possible_dirs = {{0, 1}, {0, -1}, {1, 0}, {-1, 0}};
+    possible_dirs[n_possible++] = {0, 1};
+    possible_dirs[n_possible++] = {0, -1};
+    possible_dirs[n_possible++] = {1, 0};
+    possible_dirs[n_possible++] = {-1, 0};
     dir = MoveDir{0,1};
   } else {
     // otherwise, possible directions are forward, left and right
     MoveDir dir_left = dir;
     dir_left.turn_left();
-    possible_dirs.push_back(dir_left);
+    possible_dirs[n_possible++] = dir_left;
 
-    possible_dirs.push_back(dir); 
+    possible_dirs[n_possible++] = dir; 
 
     MoveDir dir_right = dir;
     dir_right.turn_right();
-    possible_dirs.push_back(dir_right);
+    possible_dirs[n_possible++] = dir_right;
     
   }
 
-  std::vector<MoveDir> valid_dirs;
-  for (MoveDir d : possible_dirs) {
-    TilePos pos = snake->get_next_location(d);
-    if (!running_level->crashed(pos) || snake->get_body().back() == pos) 
-        valid_dirs.push_back(d);
+  MoveDir valid_dirs[4];
+  int n_valid = 0;
+  for (int i = 0; i < n_possible; ++i) {
+    TilePos pos = snake->get_next_location(possible_dirs[i]);
+    if (!running_level->crashed(pos) || snake->get_tail() == pos) 
+        valid_dirs[n_valid++] = possible_dirs[i];
     
   }
 
-  return valid_dirs.empty() ? dir : valid_dirs[random_chance(0, valid_dirs.size() - 1)];
+  return n_valid == 0 ? dir : valid_dirs[random_chance(0, n_valid - 1)];
 }
 
 int Player::random_chance(int min, int max)
@@ -56,14 +66,15 @@ int Player::random_chance(int min, int max)
   if (min == max)
     return min;
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
   std::uniform_int_distribution<> dis(min, max);
 
-  return dis(gen);
+  return dis(*rng);
 }
 
 MoveDir Player::next_move() {
+  // Past the end of the plan, keep going the same way.
+  if (!has_next_move()) return snake->get_dir();
+
   std::vector<MoveDir>::iterator aux = curr_move;
   ++curr_move;
   return *aux;
@@ -73,71 +84,410 @@ bool Player::is_valid(MoveDir dir, MoveDir curr) {
   return !(dir.dx + curr.dx == 0 && dir.dy + curr.dy == 0);
 }
 
-std::vector<MoveDir> Player::get_solution() {
+namespace {
+  //! Marks the root of the search tree, which has no parent.
+  const uint32_t no_parent = UINT32_MAX >> 2;
+
+  //! Marks an empty slot of the parallel search's cell links.
+  const uint32_t no_node = UINT32_MAX;
+}
+
+const uint32_t Player::MIN_PARALLEL_LAYER;
+
+size_t Player::state_key(uint32_t cell, unsigned dir_idx) {
+  return static_cast<size_t>(cell) * 4 + dir_idx;
+}
+
+bool Player::hits_body(uint32_t node, uint32_t cell) {
+  // Segment i of the initial body stays in place for the first length - 1 - i
+  // moves; after that it is the tail or gone.
+  uint32_t depth = nodes[node].depth;
+  if (depth < free_at[cell]) return true;
+
+  // Segment k of the body is the head of the k-th ancestor. Without reversing
+  // the snake needs at least 4 moves to come back to a cell, and on a grid it
+  // can only come back after an even number of moves, so k is odd and k >= 3.
+  size_t length = initial_body.size();
+  if (length < 5 || depth < 3) return false;
+  size_t last = std::min<size_t>(depth, length - 2);
+
+  uint32_t n = node;
+  for (size_t k = 1; k <= last; ++k) {
+    n = nodes[n].parent_move >> 2;
+    if ((k & 1) && k >= 3 && nodes[n].cell == cell) return true;
+  }
+
+  return false;
+}
+
+const std::vector<MoveDir> &Player::get_solution() const {
   return solution;
 }
 
-void Player::find_solution() {
-  struct State {
-    TilePos position;
-    std::vector<MoveDir> directions;
-    std::deque<TilePos> snake_state;
-  };
+bool Player::has_next_move() const {
+  return !solution.empty() && curr_move != solution.end();
+}
+
+void Player::set_solution(const std::vector<MoveDir> &moves) {
+  solution = moves;
+  curr_move = solution.begin();
+}
 
+bool Player::start_search() {
   solution.clear();
+  curr_move = solution.begin();
+  nodes.clear();
+  nodes_expanded = 0;
+  peak_frontier = 0;
+  searched_in_parallel = false;
+
+  visited.reset(running_level->get_cells() * 4);
+
+  long stride = running_level->get_stride();
+  for (unsigned m = 0; m < 4; ++m)
+    move_offset[m] = MOVE_CODES[m].dy * stride + MOVE_CODES[m].dx;
+
+  // Forget the body of the previous search before recording the new one.
+  if (free_at.size() < running_level->get_cells())
+    free_at.assign(running_level->get_cells(), 0);
+  for (auto cell : initial_body)
+    free_at[cell] = 0;
+
+  initial_body.clear();
+  for (auto pos : snake->get_body())
+    initial_body.push_back(running_level->cell_index(pos));
+
+  for (size_t i = 0; i < initial_body.size(); ++i)
+    free_at[initial_body[i]] = initial_body.size() - 1 - i;
+
+  MoveDir start_dir = snake->get_dir();
+  bool neutral = start_dir == MoveDir{0,0};
+
+  nodes.push_back({no_parent << 2 | (neutral ? 0 : move_code(start_dir)), initial_body[0], 0});
+  // The bitmask reachability answers for a walled off pellet without a distance field.
+  // A pellet that couldn't be placed leaves a stale location, which no search reaches.
+  uint32_t goal = running_level->cell_index(running_level->get_pellet_loc());
+  bool placed = running_level->tile_at(goal) == tile_type_e::FOOD;
+  goal_distance = placed && running_level->reachable(goal) ? running_level->distance_field(goal) : nullptr;
+  return neutral;
+}
 
-  std::queue<State> search; 
-  std::set<std::string> visited;
+void Player::build_solution(uint32_t goal) {
+  for (uint32_t n = goal; (nodes[n].parent_move >> 2) != no_parent; n = nodes[n].parent_move >> 2)
+    solution.push_back(MOVE_CODES[nodes[n].parent_move & 3]);
 
-  std::vector<MoveDir> possible_dirs = {{0,1}, {0,-1}, {-1, 0}, {1,0}};
+  std::reverse(solution.begin(), solution.end());
+  curr_move = solution.begin();
+}
 
-  State initial = {snake->get_body()[0], {{snake->get_dir()}}, snake->get_body()};
-  search.push(initial);
+bool Player::follow_distance_field() {
+  bool neutral = (nodes[0].parent_move & 3) == 0 && snake->get_dir() == MoveDir{0,0};
 
-  while(!search.empty()) {
-    State curr = search.front(); 
-    search.pop();
+  for (uint32_t curr = 0; goal_distance[nodes[curr].cell] > 0; ++curr) {
+    SearchNode node = nodes[curr];
+    uint32_t want = goal_distance[node.cell] - 1;
 
-    std::string key = std::to_string(curr.position.row) + "," + std::to_string(curr.position.col)
-                      + "," + std::to_string(curr.directions.back().dx) + "," + std::to_string(curr.directions.back().dy);
+    unsigned m = 0;
+    while (goal_distance[node.cell + move_offset[m]] != want) ++m;
 
-    if(visited.count(key) > 0) continue;
+    // Anything but the first closer cell could make a different path than the searches.
+    uint32_t cell = node.cell + move_offset[m];
+    if ((!(curr == 0 && neutral) && !is_valid(MOVE_CODES[m], MOVE_CODES[node.parent_move & 3])) || hits_body(curr, cell)) {
+      // Leave only the root for the search.
+      nodes.resize(1);
+      nodes_expanded = 0;
+      return false;
+    }
 
-    visited.insert(key);
+    nodes.push_back({curr << 2 | m, cell, node.depth + 1});
+    ++nodes_expanded;
+  }
 
-    solution = curr.directions;
+  build_solution(nodes.size() - 1);
+  return true;
+}
 
-    if(running_level->is_food(curr.position)) {
-      solution.erase(solution.begin());
-      curr_move = solution.begin();
+bool Player::blocked(uint32_t cell) {
+  tile_type_e type = running_level->tile_at(cell);
+  return type == tile_type_e::WALL || type == tile_type_e::INVISIBLE;
+}
+
+void Player::find_solution() {
+  bool neutral = start_search();
+
+  // Walled off from the pellet: no need to search.
+  if (!goal_distance || goal_distance[nodes[0].cell] == UINT32_MAX) return;
+  if (follow_distance_field()) return;
+
+  if (parallel_threshold > 0 && running_level->get_rows() * running_level->get_cols() >= parallel_threshold) {
+    find_solution_parallel(neutral);
+    return;
+  }
+
+  // The neutral direction only appears on the root, which is never revisited.
+  if (!neutral) visited.insert(state_key(nodes[0].cell, nodes[0].parent_move & 3));
+
+  // The arena is filled in breadth first order, so it doubles as the queue.
+  for (uint32_t curr = 0; curr < nodes.size(); ++curr) {
+    SearchNode node = nodes[curr];
+    ++nodes_expanded;
+
+    if (running_level->tile_at(node.cell) == tile_type_e::FOOD) {
+      build_solution(curr);
       return;
     }
 
+    for (unsigned m = 0; m < 4; ++m) {
+      if (!(curr == 0 && neutral) && !is_valid(MOVE_CODES[m], MOVE_CODES[node.parent_move & 3])) continue;
+
+      uint32_t cell = node.cell + move_offset[m];
+      if (blocked(cell)) continue;
+
+      if (visited.contains(state_key(cell, m)) || hits_body(curr, cell)) continue;
 
-    for(auto d : possible_dirs) {
-      if(!is_valid(d, curr.directions.back())) continue;
+      visited.insert(state_key(cell, m));
+      nodes.push_back({curr << 2 | m, cell, node.depth + 1});
+    }
+
+    if (nodes.size() - curr - 1 > peak_frontier) peak_frontier = nodes.size() - curr - 1;
+  }
+}
 
-      TilePos pos = {curr.position.row + d.dy, curr.position.col + d.dx};
+void Player::find_solution_parallel(bool neutral) {
+  if (!pool) pool.reset(new WorkerPool(std::max(1u, std::thread::hardware_concurrency())));
+  unsigned n_workers = pool->size();
 
-      bool body = false;
-      for(auto i{0}; i < curr.snake_state.size(); ++i) {
-        if(pos == curr.snake_state[i] && curr.snake_state.back() != pos) body = true;
+  size_t cells = running_level->get_cells();
+  shared_visited.reset(cells * 4, n_workers);
+  if (n_cell_head < cells) {
+    cell_head.reset(new std::atomic<uint32_t>[cells]);
+    for (size_t c = 0; c < cells; ++c) cell_head[c].store(no_node, std::memory_order_relaxed);
+    n_cell_head = cells;
+  }
+  searched_in_parallel = true;
+
+  if (!neutral) shared_visited.insert(state_key(nodes[0].cell, nodes[0].parent_move & 3), 0);
+
+  for (uint32_t begin = 0, end = 1; begin < end; begin = end, end = nodes.size()) {
+    size_t n = end - begin;
+    unsigned n_chunks = n < MIN_PARALLEL_LAYER ? 1 : n_workers;
+    auto run = [&](const std::function<void(unsigned)> &f) {
+      if (n_chunks == 1) f(0);
+      else pool->run(f);
+    };
+    auto first = [&](unsigned c) { return static_cast<uint32_t>(begin + n * c / n_chunks); };
+
+    if (n > peak_frontier) peak_frontier = n;
+    layer_moves.assign(n, 0);
+    layer_keep.resize(n);
+    layer_link.resize(n);
+    chunk_goal.assign(n_chunks, no_node);
+    chunk_children.assign(n_chunks + 1, 0);
+
+    // Check the moves of every node and link the ones with moves left to their cell.
+    run([&](unsigned c) {
+      for (uint32_t curr = first(c); curr < first(c + 1); ++curr) {
+        SearchNode node = nodes[curr];
+        if (running_level->tile_at(node.cell) == tile_type_e::FOOD) {
+          chunk_goal[c] = curr;
+          return;
+        }
+
+        uint8_t ok = 0;
+        for (unsigned m = 0; m < 4; ++m) {
+          if (!(curr == 0 && neutral) && !is_valid(MOVE_CODES[m], MOVE_CODES[node.parent_move & 3])) continue;
+
+          uint32_t cell = node.cell + move_offset[m];
+          if (blocked(cell)) continue;
+
+          if (shared_visited.contains(state_key(cell, m)) || hits_body(curr, cell)) continue;
+          ok |= 1 << m;
+        }
+
+        layer_moves[curr - begin] = ok;
+        if (ok) layer_link[curr - begin] = cell_head[node.cell].exchange(curr, std::memory_order_relaxed);
       }
+    });
 
-      if(running_level->get_tile_type(pos) == tile_type_e::WALL || 
-      running_level->get_tile_type(pos) == tile_type_e::INVISIBLE || body) continue; 
+    uint32_t goal = *std::min_element(chunk_goal.begin(), chunk_goal.end());
+    if (goal != no_node) {
+      for (uint32_t curr = begin; curr < end; ++curr)
+        if (layer_moves[curr - begin]) cell_head[nodes[curr].cell].store(no_node, std::memory_order_relaxed);
 
-      std::vector<MoveDir> new_dirs = curr.directions;
-      new_dirs.push_back(d);
+      // The serial search pops every node up to the goal.
+      nodes_expanded = goal + 1;
+      build_solution(goal);
+      return;
+    }
 
-      std::deque<TilePos> new_snake = curr.snake_state;
+    // A move already taken by an earlier node on the same cell leads to a visited state.
+    run([&](unsigned c) {
+      size_t children = 0;
+      for (uint32_t curr = first(c); curr < first(c + 1); ++curr) {
+        uint8_t keep = layer_moves[curr - begin];
+        if (keep) {
+          for (uint32_t q = cell_head[nodes[curr].cell].load(std::memory_order_relaxed); q != no_node; q = layer_link[q - begin])
+            if (q < curr) keep &= ~layer_moves[q - begin];
+        }
+        layer_keep[curr - begin] = keep;
+        children += (keep & 1) + (keep >> 1 & 1) + (keep >> 2 & 1) + (keep >> 3 & 1);
+      }
+      chunk_children[c + 1] = children;
+    });
+
+    for (unsigned c = 0; c < n_chunks; ++c) chunk_children[c + 1] += chunk_children[c];
+    nodes.resize(end + chunk_children[n_chunks]);
+
+    // Each chunk writes its children where the serial search would have pushed them.
+    run([&](unsigned c) {
+      uint32_t out = end + chunk_children[c];
+      for (uint32_t curr = first(c); curr < first(c + 1); ++curr) {
+        SearchNode node = nodes[curr];
+        if (layer_moves[curr - begin]) cell_head[node.cell].store(no_node, std::memory_order_relaxed);
+
+        uint8_t keep = layer_keep[curr - begin];
+        for (unsigned m = 0; m < 4; ++m) {
+          if (!(keep >> m & 1)) continue;
+
+          uint32_t cell = node.cell + move_offset[m];
+          shared_visited.insert(state_key(cell, m), c);
+          nodes[out++] = {curr << 2 | m, cell, node.depth + 1};
+        }
+      }
+    });
+  }
 
-      new_snake.push_front(pos);
-      new_snake.pop_back();
+  nodes_expanded = nodes.size();
+}
 
-      search.push({pos, new_dirs, new_snake}); 
+void Player::set_parallel_threshold(size_t cells) {
+  // With a single core the layers would only pay for the synchronization.
+  parallel_threshold = std::thread::hardware_concurrency() > 1 ? cells : 0;
+}
+
+void Player::set_heuristic(heuristic_e h) {
+  heuristic = h;
+}
+
+size_t Player::get_nodes_expanded() {
+  return nodes_expanded;
+}
+
+size_t Player::get_peak_frontier() {
+  return peak_frontier;
+}
+
+size_t Player::get_visited() {
+  return searched_in_parallel ? shared_visited.size() : visited.size();
+}
+
+uint32_t Player::estimate(uint32_t cell) {
+  if (heuristic == DISTANCE)
+    return goal_distance[cell];
+
+  TilePos goal = running_level->get_pellet_loc();
+  TilePos pos = running_level->cell_pos(cell);
+  size_t row = pos.row, col = pos.col;
+
+  return (row > goal.row ? row - goal.row : goal.row - row) +
+         (col > goal.col ? col - goal.col : goal.col - col);
+}
+
+namespace {
+  //! Orders the open list by lowest f, then deepest node, then oldest node.
+  bool open_after(const OpenEntry &a, const OpenEntry &b) {
+    if (a.f != b.f) return a.f > b.f;
+    if (a.g != b.g) return a.g < b.g;
+    return a.node > b.node;
+  }
+}
+
+void Player::find_solution_astar() {
+  bool neutral = start_search();
+
+  if (!goal_distance || goal_distance[nodes[0].cell] == UINT32_MAX) return;
+  uint32_t h = estimate(nodes[0].cell);
+  if (h == UINT32_MAX) return;
+
+  // With the MANHATTAN heuristic A* breaks ties its own way, so it always searches.
+  if (heuristic == DISTANCE && follow_distance_field()) return;
+
+  open.clear();
+  open.push_back({h, 0, 0});
+
+  // Both heuristics are consistent, so a state is closed the first time it is popped.
+  while (!open.empty()) {
+    std::pop_heap(open.begin(), open.end(), open_after);
+    OpenEntry entry = open.back();
+    open.pop_back();
+
+    SearchNode node = nodes[entry.node];
+    bool root = entry.node == 0;
+
+    if (!(root && neutral) && !visited.insert(state_key(node.cell, node.parent_move & 3))) continue;
+    ++nodes_expanded;
+
+    if (running_level->tile_at(node.cell) == tile_type_e::FOOD) {
+      build_solution(entry.node);
+      return;
     }
-    
+
+    for (unsigned m = 0; m < 4; ++m) {
+      if (!(root && neutral) && !is_valid(MOVE_CODES[m], MOVE_CODES[node.parent_move & 3])) continue;
+
+      uint32_t cell = node.cell + move_offset[m];
+      if (blocked(cell)) continue;
+
+      if (visited.contains(state_key(cell, m)) || hits_body(entry.node, cell)) continue;
+
+      uint32_t h = estimate(cell);
+      if (h == UINT32_MAX) continue;
+
+      nodes.push_back({entry.node << 2 | m, cell, node.depth + 1});
+      open.push_back({entry.g + 1 + h, entry.g + 1, static_cast<uint32_t>(nodes.size() - 1)});
+      std::push_heap(open.begin(), open.end(), open_after);
+    }
+
+    if (open.size() > peak_frontier) peak_frontier = open.size();
   }
-  solution.clear();
-}
\ No newline at end of file
+}
+
+bool Player::build_cycle() {
+  return cycle.build(*running_level);
+}
+
+bool Player::has_cycle() {
+  return !cycle.empty();
+}
+
+MoveDir Player::next_move_cycle() {
+  long stride = running_level->get_stride();
+  const long offset[4] = {stride, -stride, -1, 1};
+
+  uint32_t head = running_level->cell_index(snake->get_head());
+  uint32_t tail = running_level->cell_index(snake->get_tail());
+  uint32_t pellet = running_level->cell_index(running_level->get_pellet_loc());
+
+  size_t to_tail = snake->size() == 1 ? cycle.size() : cycle.distance(head, tail);
+  size_t to_pellet = cycle.contains(pellet) && running_level->is_food(running_level->get_pellet_loc())
+                         ? cycle.distance(head, pellet) : cycle.size();
+
+  // Following the cycle is always safe. A neighbor further ahead is a
+  // shortcut; the cells between the tail and the head, body included, are
+  // never closer than to_tail.
+  unsigned best = 0;
+  size_t best_skip = 0;
+  for (unsigned m = 0; m < 4; ++m) {
+    uint32_t cell = head + offset[m];
+    if (!cycle.contains(cell)) continue;
+
+    size_t skip = cycle.distance(head, cell);
+    bool safe = skip == 1 || (skip < to_tail && skip <= to_pellet);
+    if (safe && skip > best_skip) {
+      best = m;
+      best_skip = skip;
+    }
+  }
+
+  return MOVE_CODES[best];
+}
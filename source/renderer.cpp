@@ -0,0 +1,165 @@
+#include "../include/renderer.h"
+
+#include <cerrno>
+#include <unistd.h>
+
+namespace
+{
+    //! The text of each glyph, indexed by glyph_e.
+    const char *const symbols[] = {" ", "█", "✼", "󰯈", "", "", "", "", "●", "◌", "", "♥", "♡"};
+    // const char *const symbols[] = {" ", "█", "✼", "☹", "<", ">", "∧", "∨", "●", "◌", "⚜", "♥", "♡"}; // caso nao tenha a fonte instalada
+}
+
+const char *glyph_text(glyph_e g)
+{
+    return symbols[g];
+}
+
+void TerminalBackend::write(const char *data, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t written = ::write(STDOUT_FILENO, data, n);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        data += written;
+        n -= written;
+    }
+}
+
+FileBackend::FileBackend(const std::string &path)
+{
+    file = std::fopen(path.c_str(), "wb");
+}
+
+FileBackend::~FileBackend()
+{
+    if (file)
+        std::fclose(file);
+}
+
+bool FileBackend::is_open() const
+{
+    return file != nullptr;
+}
+
+void FileBackend::write(const char *data, size_t n)
+{
+    if (file)
+        std::fwrite(data, 1, n, file);
+}
+
+void NullBackend::write(const char *, size_t n)
+{
+    bytes += n;
+}
+
+size_t NullBackend::get_bytes() const
+{
+    return bytes;
+}
+
+void Renderer::bind_backend(RenderBackend *b)
+{
+    backend = b;
+    has_prev = false;
+}
+
+void Renderer::invalidate()
+{
+    has_prev = false;
+}
+
+void Renderer::begin_frame(size_t r, size_t c)
+{
+    text.clear();
+    rows = r;
+    cols = c;
+    cells.assign(r * c, GLYPH_EMPTY);
+}
+
+void Renderer::add_text(const std::string &s)
+{
+    size_t start = 0;
+    while (start < s.size())
+    {
+        size_t end = s.find('\n', start);
+        if (end == std::string::npos)
+            end = s.size();
+        text.push_back(s.substr(start, end - start));
+        start = end + 1;
+    }
+}
+
+void Renderer::move_to(size_t row, size_t col)
+{
+    out += "\x1b[";
+    out += std::to_string(row + 1);
+    out += ';';
+    out += std::to_string(col + 1);
+    out += 'H';
+}
+
+void Renderer::present()
+{
+    out.clear();
+
+    bool full = !has_prev || text.size() != prev_text.size() || rows != prev_rows || cols != prev_cols;
+    size_t top = text.size();
+
+    if (full)
+    {
+        // Home, clear the screen and draw everything.
+        out += "\x1b[H\x1b[2J";
+        for (auto &line : text)
+        {
+            out += line;
+            out += '\n';
+        }
+        for (size_t r = 0; r < rows; ++r)
+        {
+            for (size_t c = 0; c < cols; ++c)
+                out += symbols[cells[r * cols + c]];
+            out += '\n';
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            if (text[i] == prev_text[i])
+                continue;
+            move_to(i, 0);
+            out += text[i];
+            out += "\x1b[K";
+        }
+
+        // After a glyph the cursor is already on the next cell, so a run of
+        // changed cells needs a single cursor move.
+        size_t next = SIZE_MAX;
+        for (size_t idx = 0; idx < cells.size(); ++idx)
+        {
+            if (cells[idx] == prev_cells[idx])
+                continue;
+            if (idx != next)
+                move_to(top + idx / cols, idx % cols);
+            out += symbols[cells[idx]];
+            next = (idx + 1) % cols == 0 ? SIZE_MAX : idx + 1;
+        }
+
+        move_to(top + rows, 0);
+    }
+
+    if (backend && !out.empty())
+        backend->write(out.data(), out.size());
+
+    text.swap(prev_text);
+    cells.swap(prev_cells);
+    prev_rows = rows;
+    prev_cols = cols;
+    has_prev = true;
+}
@@ -0,0 +1,242 @@
+#include "../include/replay.h"
+#include "../include/byte_io.h"
+#include "../include/move_code.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+const uint32_t ReplayWriter::CHECKSUM_INTERVAL;
+const uint32_t ReplayWriter::NO_PELLET;
+
+namespace
+{
+    const char MAGIC[4] = {'S', 'N', 'Z', 'R'};
+    const uint32_t VERSION = 1;
+
+    //! Bytes buffered before they are written to the file.
+    const size_t FLUSH_BYTES = 1 << 16;
+}
+
+namespace
+{
+    void add_level(StateHash &hash, const Level &level) {
+        hash.add(level.get_rows());
+        hash.add(level.get_cols());
+        hash.add(level.get_spawn().row);
+        hash.add(level.get_spawn().col);
+        hash.add_bytes(level.get_grid().data(), level.get_grid().size());
+    }
+}
+
+uint64_t hash_levels(const std::vector<Level> &levels) {
+    StateHash hash;
+    for (const Level &level : levels)
+        add_level(hash, level);
+    return hash.value();
+}
+
+uint64_t hash_level(const Level &level) {
+    StateHash hash;
+    add_level(hash, level);
+    return hash.value();
+}
+
+ReplayWriter::~ReplayWriter() {
+    close();
+}
+
+bool ReplayWriter::close() {
+    if (!file) return !failed;
+
+    flush_moves();
+    flush();
+    if (std::fflush(file) != 0) failed = true;
+    if (std::fclose(file) != 0) failed = true;
+    file = nullptr;
+    return !failed;
+}
+
+bool ReplayWriter::open(const std::string &path, const ReplayHeader &header) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    out.append(MAGIC, sizeof(MAGIC));
+    put_u32(out, VERSION);
+    put_u64(out, header.levels_hash);
+    put_u64(out, header.seed);
+    put_u32(out, header.lives);
+    put_u32(out, header.food);
+    put_u64(out, header.max_ticks);
+    put_u32(out, header.checksum_interval);
+    return true;
+}
+
+void ReplayWriter::flush_moves() {
+    if (n_moves == 0) return;
+
+    out += 'M';
+    put_u32(out, n_moves);
+    out.append(moves.begin(), moves.end());
+    moves.clear();
+    n_moves = 0;
+
+    if (out.size() >= FLUSH_BYTES) flush();
+}
+
+void ReplayWriter::flush() {
+    if (!out.empty() && std::fwrite(out.data(), 1, out.size(), file) != out.size()) failed = true;
+    out.clear();
+}
+
+bool ReplayWriter::move(const MoveDir dir) {
+    unsigned code = move_code(dir);
+    if (code == NEUTRAL_CODE) return false;
+
+    if (n_moves % 4 == 0) moves.push_back(0);
+    moves.back() |= code << (2 * (n_moves % 4));
+    ++n_moves;
+    return true;
+}
+
+void ReplayWriter::pellet(const bool placed, const TilePos pos) {
+    flush_moves();
+    out += 'P';
+    put_u32(out, placed ? pos.row : NO_PELLET);
+    put_u32(out, placed ? pos.col : NO_PELLET);
+}
+
+void ReplayWriter::checksum(const uint64_t tick, const uint64_t sum, const bool end) {
+    flush_moves();
+    out += end ? 'E' : 'C';
+    put_u64(out, tick);
+    put_u64(out, sum);
+
+    if (end || out.size() >= FLUSH_BYTES) flush();
+    if (end && std::fflush(file) != 0) failed = true;
+}
+
+ReplayHeader ReplayReader::open(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Unable to open replay file.\n");
+
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    if (!has(sizeof(MAGIC) + 40) || std::memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("The file is not a replay log.\n");
+    pos = sizeof(MAGIC);
+
+    if (u32() != VERSION)
+        throw std::runtime_error("Unsupported version of the replay log.\n");
+
+    ReplayHeader header;
+    header.levels_hash = u64();
+    header.seed = u64();
+    header.lives = u32();
+    header.food = u32();
+    header.max_ticks = u64();
+    header.checksum_interval = u32();
+    if (header.checksum_interval == 0)
+        throw std::runtime_error("The replay log is corrupted.\n");
+
+    // A recording that was interrupted may end in the middle of a record: drop it.
+    size_t end = pos;
+    while (end < data.size()) {
+        size_t size;
+        if (data[end] == 'M') {
+            size = 5;
+            if (data.size() - end >= 5) {
+                // Widened first: a count near 2^32 would wrap to a short record.
+                size_t n = get_u32(&data[end + 1]);
+                if (n == 0 || (header.max_ticks > 0 && n > header.max_ticks))
+                    throw std::runtime_error("The replay log is corrupted.\n");
+                size += (n + 3) / 4;
+            }
+        }
+        else if (data[end] == 'P')
+            size = 9;
+        else if (data[end] == 'C' || data[end] == 'E')
+            size = 17;
+        else
+            throw std::runtime_error("The replay log is corrupted.\n");
+
+        if (data.size() - end < size) break;
+        end += size;
+    }
+    data.resize(end);
+
+    open_flag = true;
+    return header;
+}
+
+uint32_t ReplayReader::u32() {
+    uint32_t v = get_u32(&data[pos]);
+    pos += 4;
+    return v;
+}
+
+uint64_t ReplayReader::u64() {
+    uint64_t low = u32();
+    return low | static_cast<uint64_t>(u32()) << 32;
+}
+
+bool ReplayReader::take_tag(const char tag) {
+    if (moves_left > 0 || !has(1) || data[pos] != static_cast<uint8_t>(tag)) return false;
+    ++pos;
+    return true;
+}
+
+bool ReplayReader::next_move(MoveDir &dir) {
+    if (moves_left == 0) {
+        size_t start = pos;
+        if (!take_tag('M') || !has(4)) {
+            pos = start;
+            return false;
+        }
+
+        uint32_t n = u32();
+        size_t packed = (static_cast<size_t>(n) + 3) / 4;
+        if (n == 0 || !has(packed)) {
+            pos = start;
+            return false;
+        }
+
+        moves_left = n;
+        move_index = 0;
+        moves_start = pos;
+        pos += packed;
+    }
+
+    dir = MOVE_CODES[data[moves_start + move_index / 4] >> (2 * (move_index % 4)) & 3];
+    ++move_index;
+    --moves_left;
+    return true;
+}
+
+bool ReplayReader::next_pellet(bool &placed, TilePos &loc) {
+    size_t start = pos;
+    if (!take_tag('P') || !has(8)) {
+        pos = start;
+        return false;
+    }
+
+    uint32_t row = u32(), col = u32();
+    placed = row != ReplayWriter::NO_PELLET;
+    loc = {row, col};
+    return true;
+}
+
+bool ReplayReader::next_checksum(uint64_t &tick, uint64_t &sum, bool &end) {
+    size_t start = pos;
+    end = has(1) && data[pos] == 'E';
+    if (!(take_tag('C') || take_tag('E')) || !has(16)) {
+        pos = start;
+        return false;
+    }
+
+    tick = u64();
+    sum = u64();
+    return true;
+}
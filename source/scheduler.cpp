@@ -0,0 +1,56 @@
+#include "../include/scheduler.h"
+
+#include <cmath>
+#include <thread>
+
+const int TickScheduler::MAX_LAG;
+
+void TickScheduler::set_rate(const int tps) {
+    period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / tps));
+}
+
+void TickScheduler::reset() {
+    started = false;
+}
+
+void TickScheduler::wait() {
+    if (!started) {
+        deadline = clock::now();
+        started = true;
+    }
+
+    deadline += period;
+    std::this_thread::sleep_until(deadline);
+
+    clock::time_point now = clock::now();
+    double late_ms = std::chrono::duration<double, std::milli>(now - deadline).count();
+
+    ++samples;
+    sum_ms += late_ms;
+    sum_sq_ms += late_ms * late_ms;
+    if (late_ms > max_ms) max_ms = late_ms;
+
+    // Catch up in small steps, but never replay a long stall tick by tick.
+    if (now - deadline > MAX_LAG * period)
+        deadline = now;
+}
+
+double TickScheduler::mean_jitter_ms() const {
+    return samples > 0 ? sum_ms / samples : 0;
+}
+
+double TickScheduler::stddev_jitter_ms() const {
+    if (samples == 0) return 0;
+
+    double mean = mean_jitter_ms();
+    double variance = sum_sq_ms / samples - mean * mean;
+    return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+double TickScheduler::max_jitter_ms() const {
+    return max_ms;
+}
+
+unsigned long TickScheduler::get_samples() const {
+    return samples;
+}
@@ -1,37 +1,105 @@
 #include "../include/simulation.h"
+#include "../include/move_code.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <cctype>
+#include <cstring>
 #include <stdexcept>
-#include <fstream>
 #include <chrono>
 #include <thread>
 
 #include <cstdlib>
 
+namespace
+{
+    /**
+     * @brief Lower-case a command line value, so options are matched ignoring case.
+     */
+    std::string to_lower(std::string s)
+    {
+        for (size_t j{0}; j < s.length(); ++j)
+            s[j] = std::tolower(s[j]);
+        return s;
+    }
+
+    /**
+     * @brief Parse a command line value as an unsigned number, which std::stoul alone
+     * would take from a negative one by wrapping it around.
+     *
+     * @throw std::invalid_argument if the value is negative or not a number.
+     */
+    unsigned long to_unsigned(const std::string &s)
+    {
+        size_t first = s.find_first_not_of(" \t");
+        if (first != std::string::npos && s[first] == '-')
+            throw std::invalid_argument(s);
+        return std::stoul(s);
+    }
+
+    /**
+     * @brief Adds the time between its construction and destruction to a counter.
+     */
+    class PhaseTimer
+    {
+    private:
+        double &total_ms;                            //<! The counter.
+        std::chrono::steady_clock::time_point start; //<! When the timer was created.
+
+    public:
+        explicit PhaseTimer(double &ms) : total_ms(ms), start(std::chrono::steady_clock::now()) {}
+
+        ~PhaseTimer()
+        {
+            total_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+}
+
 std::string snz::SnakeSimulation::options()
 {
     std::ostringstream oss;
     oss << "Usage: snaze [<options>] <input_level_file>\n"
+        << "       snaze [<options>] --generate <W>x<H>\n"
         << "   Game simulation options:\n"
         << "       --help                  Print this help text.\n"
         << "       --fps <num>             Number of frames (board) presented per second. Default = 12. Valid range = [1, 50]\n"
+        << "       --tps <num>             Number of simulation ticks per second. Default = fps. Valid range = [1, 1000]\n"
         << "       --lives <num>           Number of lives the snake shall have. Default = 5. Valid range = [1, 20]\n"
         << "       --food <num>            Number of food pellets for the entire simulation. Default = 10.Valid range = [1, 20]\n"
-        << "       --playertype <type>     Type of snake intelligence: random, backtracking. Default = backtracking.\n";
+        << "       --playertype <type>     Type of snake intelligence: random, backtracking, astar, cycle. Default = backtracking.\n"
+        << "       --heuristic <type>      Heuristic of the astar player: manhattan, distance. Default = distance.\n"
+        << "       --headless              Run at full speed without drawing or waiting for <ENTER>, then print a JSON summary.\n"
+        << "       --max-ticks <num>       End the game after this many ticks. Default = 0 (no limit).\n"
+        << "       --seed <num>            Seed of the random engine; the same seed and level file replay the same game. Default = random.\n"
+        << "       --render <type>         Where frames are drawn: terminal, file, null. Default = terminal.\n"
+        << "       --render-file <path>    File written by the file renderer. Default = snaze_render.log.\n"
+        << "       --generate <W>x<H>      Play a maze of W columns and H rows generated from --seed instead of a level file. Valid range = [1, 4096], with room for the snake and every pellet\n"
+        << "       --stats <path>          Append the planner, timing and life counters to <path> as JSON lines, the last one at exit.\n"
+        << "       --stats-interval <num>  Ticks between two --stats snapshots. Default = 0 (only at exit).\n"
+        << "       --record <path>         Record the pellets and moves of the game to a replay log.\n"
+        << "       --replay <path>         Play a replay log back at full speed on the same levels, checking it against the recorded game.\n"
+        << "                               Nothing is drawn unless --render is given.\n"
+        << "       --parallel-threshold <num>  Board cells (rows times columns) from which the backtracking planner uses every core. Default = 262144, 0 = never.\n"
+        << "       --planner <type>        Where the player searches: sync (between frames), async (on a worker thread while the frames go on).\n"
+        << "                               Default = async when drawing, sync otherwise. Recording and replaying are always sync.\n"
+        << "       --plan-cache <path>     Load the plans of states searched before from <path>, if it exists, and save them there at exit.\n"
+        << "       --plan-cache-size <num> Most plans kept in the cache, the least recently used dropped first. Default = 4096, 0 = no cache.\n";
     return oss.str();
 }
 
 void snz::SnakeSimulation::print_welcome(void)
 {
-    std::cout << "\n-------------> Welcome to the classic Snaze Game <-------------\n"
-              << "   copyright (C) 2023, Tobias dos Santos and Wisla Argolo.\n"
-              << "---------------------------------------------------------------\n"
-              << " Levels loaded: " << levels.size() << " | Snake lives: " << opt.lives << " | Foods to eat: " << opt.n_food_pellets_per_nivel << "\n"
-              << " Clear all levels to win the game. Good luck!!!\n"
-              << "---------------------------------------------------------------\n"
-              << ">>> Press <ENTER> to start the game!\n\n";
+    std::ostringstream oss;
+    oss << "\n-------------> Welcome to the classic Snaze Game <-------------\n"
+        << "   copyright (C) 2023, Tobias dos Santos and Wisla Argolo.\n"
+        << "---------------------------------------------------------------\n"
+        << " Levels loaded: " << levels.size() << " | Snake lives: " << opt.lives << " | Foods to eat: " << opt.n_food_pellets_per_nivel << "\n"
+        << " Clear all levels to win the game. Good luck!!!\n"
+        << "---------------------------------------------------------------\n"
+        << ">>> Press <ENTER> to start the game!\n\n";
+    renderer.add_text(oss.str());
 }
 
 void snz::SnakeSimulation::init_running_level()
@@ -41,7 +109,106 @@ void snz::SnakeSimulation::init_running_level()
     player.bind_level(&(*running_level));
     snake.init();
 
-    running_level->place_pellet();
+    // Built before the pellet is placed, while the level only has the snake's head.
+    if (opt.player_type == "cycle" && !replayer.is_open())
+        player.build_cycle();
+
+    if (planner)
+        planner->load_level(*running_level);
+
+    place_pellet();
+}
+
+void snz::SnakeSimulation::place_pellet()
+{
+    PhaseTimer timer(stats.pellet_ms);
+    ++stats.pellets_placed;
+
+    if (replayer.is_open())
+    {
+        bool placed;
+        TilePos loc;
+        if (!replayer.next_pellet(placed, loc))
+            replay_mismatch("no pellet in the log");
+        else if (placed && !running_level->place_pellet_at(loc))
+            replay_mismatch("the pellet is not on an empty tile");
+        return;
+    }
+
+    bool placed = running_level->place_pellet(rng);
+    if (recorder.is_open())
+        recorder.pellet(placed, running_level->get_pellet_loc());
+}
+
+bool snz::SnakeSimulation::needs_plan()
+{
+    // Levels without a cycle fall back to search.
+    return opt.player_type == "backtracking" || opt.player_type == "astar" ||
+           (opt.player_type == "cycle" && !player.has_cycle());
+}
+
+void snz::SnakeSimulation::plan()
+{
+    if (!needs_plan())
+        return;
+
+    PlanState state;
+    bool cacheable = plan_state(state);
+    if (cacheable && use_cached_plan(state))
+        return;
+
+    if(opt.player_type == "astar")
+        player.find_solution_astar();
+    else
+        player.find_solution();
+    record_search(player);
+
+    if (cacheable)
+        plan_cache.insert(state, player.get_solution());
+}
+
+bool snz::SnakeSimulation::plan_state(PlanState &state)
+{
+    // Without a pellet the search fails wherever the last one was.
+    if (opt.plan_cache_size == 0 || snake.size() > PlanCache::MAX_BODY || !running_level->is_food(running_level->get_pellet_loc()))
+        return false;
+
+    state.level = level_keys[running_level - levels.begin()];
+    if (opt.player_type != "astar")
+        state.planner = PLAN_BFS;
+    else
+        state.planner = opt.heuristic == "manhattan" ? PLAN_ASTAR_MANHATTAN : PLAN_ASTAR_DISTANCE;
+    state.dir = move_code(snake.get_dir());
+    state.pellet = running_level->get_pellet_loc();
+    state.body.clear();
+    for (const auto &tile_pos : snake.get_body())
+        state.body.push_back(tile_pos);
+
+    // The snake keeps the key of its body up to date as it moves.
+    state.key = plan_key(state.level, state.planner, state.dir, state.pellet, snake.get_head(), snake.get_body_key());
+    return true;
+}
+
+bool snz::SnakeSimulation::use_cached_plan(const PlanState &state)
+{
+    std::vector<MoveDir> moves;
+    if (!plan_cache.lookup(state, moves))
+    {
+        ++stats.plan_cache_misses;
+        return false;
+    }
+
+    ++stats.plan_cache_hits;
+    player.set_solution(moves);
+    return true;
+}
+
+void snz::SnakeSimulation::record_search(Player &p)
+{
+    ++stats.planner_calls;
+    stats.nodes_expanded += p.get_nodes_expanded();
+    stats.peak_frontier = std::max(stats.peak_frontier, p.get_peak_frontier());
+    stats.peak_visited = std::max(stats.peak_visited, p.get_visited());
 }
 
 snz::SimulationResult snz::SnakeSimulation::initialize(int argc, char *argv[])
@@ -53,15 +220,81 @@ snz::SimulationResult snz::SnakeSimulation::initialize(int argc, char *argv[])
 
     for (auto i{1}; i < argc; ++i)
     {
-        std::string str = argv[i];
-
-        for (auto j{0}; j < str.length(); ++j)
-            str[j] = std::tolower(str[j]);
+        std::string str = to_lower(argv[i]);
 
         if (str == "--help" || str == "--h")
         {
             return {ERROR, options()};
         }
+        else if (str == "--headless")
+        {
+            opt.headless = true;
+        }
+        else if (str == "--max-ticks")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No max ticks value provided.\n"};
+            }
+
+            try
+            {
+                opt.max_ticks = to_unsigned(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for max ticks.\n"};
+            }
+        }
+        else if (str == "--seed")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No seed value provided.\n"};
+            }
+
+            try
+            {
+                opt.seed = to_unsigned(argv[++i]);
+                opt.has_seed = true;
+            }
+            catch (const std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for seed.\n"};
+            }
+        }
+        else if (str == "--render")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No render value provided.\n"};
+            }
+
+            std::string aux = to_lower(argv[++i]);
+
+            if(!(aux == "terminal" || aux == "file" || aux == "null")) {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! Invalid value for render.\n"};
+            }
+
+            opt.render = aux;
+            opt.render_set = true;
+        }
+        else if (str == "--render-file")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No render file provided.\n"};
+            }
+
+            opt.render_file = argv[++i];
+            opt.render = "file";
+            opt.render_set = true;
+        }
         else if (str == "--fps")
         {
             if (i + 1 == argc)
@@ -82,6 +315,26 @@ snz::SimulationResult snz::SnakeSimulation::initialize(int argc, char *argv[])
             if (opt.fps < 1 || 50 < opt.fps)
                 return {ERROR, ">>> ERROR! Invalid value for FPS. Valid range is [1,50]\n"};
         }
+        else if (str == "--tps")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No TPS value provided.\n"};
+            }
+
+            try
+            {
+                opt.tps = std::stoi(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for TPS.\n"};
+            }
+
+            if (opt.tps < 1 || 1000 < opt.tps)
+                return {ERROR, ">>> ERROR! Invalid value for TPS. Valid range is [1,1000]\n"};
+        }
         else if (str == "--lives" || str == "--l")
         {
             if (i + 1 == argc)
@@ -132,20 +385,171 @@ snz::SimulationResult snz::SnakeSimulation::initialize(int argc, char *argv[])
                 return {ERROR, ">>> ERROR! No player type value provided.\n"};
             }
 
-            std::string aux = argv[++i];
-            for (auto j{0}; j < aux.length(); ++j)
-                aux[j] = std::tolower(aux[j]);
+            std::string aux = to_lower(argv[++i]);
 
 
-            if(!(aux == "random" || aux == "backtracking")) {
+            if(!(aux == "random" || aux == "backtracking" || aux == "astar" || aux == "cycle")) {
                 std::cout << options();
                 return {ERROR, ">>> ERROR! Invalid value for player type.\n"};
             }
 
             opt.player_type = aux;
         }
+        else if (str == "--heuristic")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No heuristic value provided.\n"};
+            }
+
+            std::string aux = to_lower(argv[++i]);
+
+            if(!(aux == "manhattan" || aux == "distance")) {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! Invalid value for heuristic.\n"};
+            }
+
+            opt.heuristic = aux;
+        }
+        else if (str == "--generate")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No maze size provided.\n"};
+            }
+
+            std::string aux = argv[++i];
+            size_t x = aux.find_first_of("xX");
+            try
+            {
+                size_t end_w, end_h;
+                opt.generate_cols = std::stoul(aux.substr(0, x), &end_w);
+                opt.generate_rows = std::stoul(aux.substr(x + 1), &end_h);
+                if (x == std::string::npos || end_w != x || end_h != aux.size() - x - 1)
+                    throw std::invalid_argument(aux);
+            }
+            catch (std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for maze size. Use <W>x<H>, e.g. 512x512.\n"};
+            }
+
+            if (opt.generate_cols < 1 || opt.generate_rows < 1 || opt.generate_cols > Level::MAX_SIZE || opt.generate_rows > Level::MAX_SIZE)
+                return {ERROR, ">>> ERROR! Invalid value for maze size. Valid range is [1,4096]\n"};
+
+            file = true;
+        }
+        else if (str == "--record")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No record file provided.\n"};
+            }
+
+            opt.record_file = argv[++i];
+        }
+        else if (str == "--replay")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No replay file provided.\n"};
+            }
+
+            opt.replay_file = argv[++i];
+        }
+        else if (str == "--parallel-threshold")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No parallel threshold value provided.\n"};
+            }
+
+            try
+            {
+                opt.parallel_threshold = to_unsigned(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for parallel threshold.\n"};
+            }
+        }
+        else if (str == "--planner")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No planner value provided.\n"};
+            }
+
+            std::string aux = to_lower(argv[++i]);
+
+            if(!(aux == "sync" || aux == "async")) {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! Invalid value for planner.\n"};
+            }
+
+            opt.planner = aux;
+        }
+        else if (str == "--plan-cache")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No plan cache file provided.\n"};
+            }
+
+            opt.plan_cache_file = argv[++i];
+        }
+        else if (str == "--plan-cache-size")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No plan cache size value provided.\n"};
+            }
+
+            try
+            {
+                opt.plan_cache_size = to_unsigned(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for plan cache size.\n"};
+            }
+        }
+        else if (str == "--stats")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No stats file provided.\n"};
+            }
+
+            opt.stats_file = argv[++i];
+        }
+        else if (str == "--stats-interval")
+        {
+            if (i + 1 == argc)
+            {
+                std::cout << options();
+                return {ERROR, ">>> ERROR! No stats interval value provided.\n"};
+            }
+
+            try
+            {
+                opt.stats_interval = to_unsigned(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                return {ERROR, ">>> ERROR! Invalid value for stats interval.\n"};
+            }
+        }
         else {
-            opt.file_name = str;
+            opt.file_name = argv[i];
             file = true;
         }
     }
@@ -155,6 +559,37 @@ snz::SimulationResult snz::SnakeSimulation::initialize(int argc, char *argv[])
         return {ERROR, ">>> ERROR! No file name provided.\n"};
     }
 
+    if (!opt.record_file.empty() && !opt.replay_file.empty())
+        return {ERROR, ">>> ERROR! A game can't be recorded and replayed at once.\n"};
+
+    ReplayHeader header;
+    if (!opt.replay_file.empty())
+    {
+        try
+        {
+            header = replayer.open(opt.replay_file);
+        }
+        catch (std::exception &e)
+        {
+            return {ERROR, ">>> ERROR! Read replay problem: " + std::string(e.what())};
+        }
+
+        // The log decides everything that changes how the game goes.
+        opt.seed = header.seed;
+        opt.has_seed = true;
+        opt.lives = header.lives;
+        snake.set_lives(header.lives);
+        opt.n_food_pellets_per_nivel = header.food;
+        opt.max_ticks = header.max_ticks;
+        checksum_interval = header.checksum_interval;
+        if (!opt.render_set)
+            opt.headless = true;
+    }
+
+    // The maze generator needs the seed before the levels are read.
+    if (!opt.has_seed)
+        opt.seed = std::random_device()();
+
     try
     {
         read_levels();
@@ -164,76 +599,102 @@ snz::SimulationResult snz::SnakeSimulation::initialize(int argc, char *argv[])
         return {ERROR, ">>> ERROR! Read file problem: " + std::string(e.what())};
     }
 
+    for (const Level &level : levels)
+        level_keys.push_back(hash_level(level));
 
-
-    //if(opt.player_type == "backtracking") player = new BTSPlayer();
-    //else player = new RandomSPlayer();
-
-    state = simulation_state_e::START;
-    player.bind_snake(&snake);
-
-    return {OK, ">>> OK! Game initialized."};
-}
-
-void snz::SnakeSimulation::read_levels()
-{
-    std::ifstream file(opt.file_name);
-
-    if (!file.is_open())
-        throw std::runtime_error("Unable to open level file.\n");
-
-    std::string line;
-
-    while (std::getline(file, line))
+    plan_cache.set_capacity(opt.plan_cache_size);
+    if (!opt.plan_cache_file.empty())
     {
-
-        if (!line.empty())
+        try
+        {
+            plan_cache.load(opt.plan_cache_file);
+        }
+        catch (std::exception &e)
         {
-            Level level;
-            bool is_valid = false;
+            return {ERROR, ">>> ERROR! Read plan cache problem: " + std::string(e.what())};
+        }
+        save_plan_cache = true;
+    }
 
-            std::istringstream ss(line);
-            int r, c;
+    if (replayer.is_open() && hash_levels(levels) != header.levels_hash)
+        return {ERROR, ">>> ERROR! The replay log was recorded on other levels.\n"};
 
-            if (!(ss >> r >> c) || r < 1 || c < 1 || c > 100 || r > 100)
-                throw std::runtime_error("The values for number of rows and columns is invalid. Valid range is [1,100]\n");
+    if (!opt.record_file.empty())
+    {
+        header = {hash_levels(levels), opt.seed, opt.lives, static_cast<uint32_t>(opt.n_food_pellets_per_nivel),
+                  opt.max_ticks, checksum_interval};
+        if (!recorder.open(opt.record_file, header))
+            return {ERROR, ">>> ERROR! Unable to open record file.\n"};
+    }
 
-            level.set_rows(r);
-            level.set_cols(c);
 
-            for (unsigned long i{0}; i < r; ++i)
-            {
-                std::getline(file, line);
 
-                std::string aux;
+    //if(opt.player_type == "backtracking") player = new BTSPlayer();
+    //else player = new RandomSPlayer();
 
-                for (char c : line) {
-                    if (c != '\r') aux += c;
-                }
+    if (opt.render == "file")
+    {
+        FileBackend *file_backend = new FileBackend(opt.render_file);
+        backend.reset(file_backend);
+        if (!file_backend->is_open())
+            return {ERROR, ">>> ERROR! Unable to open render file.\n"};
+    }
+    else if (opt.render == "null")
+        backend.reset(new NullBackend());
+    else
+        backend.reset(new TerminalBackend());
+    renderer.bind_backend(backend.get());
 
-                line = aux;
+    if (!opt.stats_file.empty())
+    {
+        stats_out.open(opt.stats_file, std::ios::app);
+        if (!stats_out)
+            return {ERROR, ">>> ERROR! Unable to open stats file.\n"};
+    }
 
-                for (char c : line)
-                {
-                    if (c != '#' && c != '*' && c != '.' && c != ' ')
-                        throw std::runtime_error("The file could not be read. It shows unexpected symbols.\n");
-                }
+    if (opt.tps == 0)
+        opt.tps = opt.fps;
+    scheduler.set_rate(opt.tps);
+    render_every = opt.tps > opt.fps ? (opt.tps + opt.fps / 2) / opt.fps : 1;
 
-                level.add_line(line);
+    rng.seed(opt.seed);
 
-                size_t spawn_pos = line.find('*');
+    state = simulation_state_e::START;
+    player.bind_snake(&snake);
+    player.bind_rng(&rng);
+    player.set_heuristic(opt.heuristic == "manhattan" ? heuristic_e::MANHATTAN : heuristic_e::DISTANCE);
+    player.set_parallel_threshold(opt.parallel_threshold);
+
+    // A replay plays THINKING in a single tick, so a recorded game must too.
+    if (opt.planner.empty())
+        opt.planner = opt.headless ? "sync" : "async";
+    if (!opt.record_file.empty() || replayer.is_open())
+        opt.planner = "sync";
+    if (opt.planner == "async" && opt.player_type != "random")
+    {
+        planner.reset(new AsyncPlanner());
+        planner->configure(opt.player_type == "astar", opt.heuristic == "manhattan" ? heuristic_e::MANHATTAN : heuristic_e::DISTANCE,
+                           opt.parallel_threshold);
+    }
 
-                if (spawn_pos != std::string::npos)
-                {
-                    level.set_spawn({i, spawn_pos});
-                    is_valid = true;
-                }
-            }
+    return {OK, ">>> OK! Game initialized."};
+}
 
-            if (is_valid)
-                levels.push_back(level);
-        }
+void snz::SnakeSimulation::read_levels()
+{
+    if (opt.generate_rows > 0)
+    {
+        levels.push_back(generate_maze(opt.generate_rows, opt.generate_cols, opt.seed));
+
+        // The last pellet needs a free cell next to a snake that ate all the others.
+        size_t needed = opt.n_food_pellets_per_nivel + 1;
+        if (levels.back().get_walkable() < needed)
+            throw std::runtime_error("The maze has " + std::to_string(levels.back().get_walkable()) +
+                                     " open cells, but " + std::to_string(opt.n_food_pellets_per_nivel) +
+                                     " pellets need " + std::to_string(needed) + ". Generate a larger maze.");
     }
+    else
+        load_levels(opt.file_name, levels);
 
     if (levels.empty())
       throw std::runtime_error("No levels found in file.");
@@ -253,115 +714,186 @@ std::string snz::SnakeSimulation::repeat_string(const std::string s, int n)
 
 void snz::SnakeSimulation::render_board()
 {
-
-    std::string symbols[] = {"✼", "󰯈", "", "", "", "", "●", "♥", "♡", "", "█", "◌"};
-    // std::string symbols [] = {"✼", "☹", "<", ">", "∧", "∨", "●","♥", "♡", "⚜", "█", "◌"} // caso nao tenha a fonte instalada
-
-    std::cout << "Lives: " << repeat_string(symbols[7], snake.get_lives()) << repeat_string(symbols[8], opt.lives - snake.get_lives())
-              << " | Score: " << score << " | Food eaten: " << consumed_pellets
-              << " of " << opt.n_food_pellets_per_nivel << " | Level: "
-              << std::distance(levels.begin(), running_level) + 1 << " of " << levels.size() << "\n";
-    std::cout << "------------------------------------------------------------------\n";
+    std::ostringstream hud;
+    hud << "Lives: " << repeat_string(glyph_text(GLYPH_LIFE), snake.get_lives()) << repeat_string(glyph_text(GLYPH_LOST_LIFE), opt.lives - snake.get_lives())
+        << " | Score: " << score << " | Food eaten: " << consumed_pellets
+        << " of " << opt.n_food_pellets_per_nivel << " | Level: "
+        << std::distance(levels.begin(), running_level) + 1 << " of " << levels.size() << "\n";
+    hud << "------------------------------------------------------------------\n";
+    renderer.add_text(hud.str());
 
     size_t rows = running_level->get_rows();
     size_t cols = running_level->get_cols();
 
+    glyph_e head = GLYPH_HEAD_START;
+    if (state == simulation_state_e::START)
+        head = GLYPH_HEAD_START;
+    else if (state == simulation_state_e::CRASH || (state == simulation_state_e::GAME_OVER && snake.get_lives() == 0))
+        head = GLYPH_HEAD_DEAD;
+    else if (snake.get_dir().dy == 1)
+        head = GLYPH_HEAD_DOWN;
+    else if (snake.get_dir().dy == -1)
+        head = GLYPH_HEAD_UP;
+    else if (snake.get_dir().dx == 1)
+        head = GLYPH_HEAD_RIGHT;
+    else if (snake.get_dir().dx == -1)
+        head = GLYPH_HEAD_LEFT;
+
+    glyph_e body = state == simulation_state_e::CRASH ? GLYPH_BODY_DEAD : GLYPH_BODY;
+
     for (size_t i{0}; i < rows; ++i)
     {
         for (size_t j{0}; j < cols; ++j)
         {
-            tile_type_e type = running_level->get_tile_type({i, j});
-
-            switch (type)
+            switch (running_level->get_tile_type({i, j}))
             {
             case tile_type_e::EMPTY:
-                std::cout << " ";
-                break;
             case tile_type_e::INVISIBLE:
-                std::cout << " ";
+                renderer.set_cell(i, j, GLYPH_EMPTY);
                 break;
             case tile_type_e::WALL:
-                std::cout << symbols[10];
+                renderer.set_cell(i, j, GLYPH_WALL);
                 break;
             case tile_type_e::SNAKEHEAD:
-                if (state == simulation_state_e::START)
-                    std::cout << symbols[0];
-                else if (state == simulation_state_e::CRASH || (state == simulation_state_e::GAME_OVER && snake.get_lives() == 0))
-                    std::cout << symbols[1];
-                else
-                {
-                    if (snake.get_dir().dy == 1)
-                        std::cout << symbols[4];
-                    else if (snake.get_dir().dy == -1)
-                        std::cout << symbols[5];
-                    else if (snake.get_dir().dx == 1)
-                        std::cout << symbols[2];
-                    else if (snake.get_dir().dx == -1)
-                        std::cout << symbols[3];
-                    else if(snake.get_dir() == MoveDir{0,0})
-                        std::cout << symbols[0];
-                }
+                renderer.set_cell(i, j, head);
                 break;
             case tile_type_e::SNAKEBODY:
-                if (state == simulation_state_e::CRASH) 
-                    std::cout << symbols[11];
-                else
-                    std::cout << symbols[6];
+                renderer.set_cell(i, j, body);
                 break;
             case tile_type_e::FOOD:
-                std::cout << symbols[9];
+                renderer.set_cell(i, j, GLYPH_FOOD);
                 break;
             }
         }
-        std::cout << std::endl;
     }
 }
 
 void snz::SnakeSimulation::print_level_up()
 {
-    std::cout << "\nYeah! The snake advanced to the next level!\n"
-              << ">>> Press <ENTER> to start the next level.\n"
-              << "---------------------------------------------------------------\n\n";
+    std::ostringstream oss;
+    oss << "\nYeah! The snake advanced to the next level!\n"
+        << ">>> Press <ENTER> to start the next level.\n"
+        << "---------------------------------------------------------------\n\n";
+    renderer.add_text(oss.str());
 }
 
 void snz::SnakeSimulation::print_crashed()
 {
-    std::cout << "\nOh no! The snake crashed!\n"
-              << ">>> Press <ENTER> to try again.\n"
-              << "---------------------------------------------------------------\n\n";
+    std::ostringstream oss;
+    oss << "\nOh no! The snake crashed!\n"
+        << ">>> Press <ENTER> to try again.\n"
+        << "---------------------------------------------------------------\n\n";
+    renderer.add_text(oss.str());
 }
 
 void snz::SnakeSimulation::print_won()
 {
-    std::cout << "\n+-------------------------------------+\n"
-              << "|       CONGRATS! The snake WON!      |\n"
-              << "|         Thanks for playing!         |\n"
-              << "+-------------------------------------+\n";
+    std::ostringstream oss;
+    oss << "\n+-------------------------------------+\n"
+        << "|       CONGRATS! The snake WON!      |\n"
+        << "|         Thanks for playing!         |\n"
+        << "+-------------------------------------+\n";
+    renderer.add_text(oss.str());
 }
 
 void snz::SnakeSimulation::print_lost()
 {
-    std::cout << "\n+-------------------------------------+\n"
-              << "|        OH NO! The snake LOSE!       |\n"
-              << "|         Thanks for playing!         |\n"
-              << "+-------------------------------------+\n";
+    std::ostringstream oss;
+    oss << "\n+-------------------------------------+\n"
+        << "|        OH NO! The snake LOSE!       |\n"
+        << "|         Thanks for playing!         |\n"
+        << "+-------------------------------------+\n";
+    renderer.add_text(oss.str());
+}
+
+void snz::SnakeSimulation::print_timing()
+{
+    std::ostringstream oss;
+    oss.precision(3);
+    oss << "Ticks: " << ticks << " at " << opt.tps << " tps, drawing every " << render_every
+        << " | Frame jitter: mean " << scheduler.mean_jitter_ms() << " ms, stddev "
+        << scheduler.stddev_jitter_ms() << " ms, max " << scheduler.max_jitter_ms() << " ms\n";
+    renderer.add_text(oss.str());
+}
+
+void snz::SnakeSimulation::wait_next_tick()
+{
+    if (opt.headless || replayer.is_open() || (state == simulation_state_e::THINKING && !planner))
+        return;
+
+    scheduler.wait();
+}
+
+void snz::SnakeSimulation::print_summary()
+{
+    SimulationSummary s = summary();
+
+    std::cout << "{\"score\": " << s.score << ", \"pellets\": " << s.pellets
+              << ", \"lives\": " << s.lives << ", \"crashes\": " << s.crashes << ", \"ticks\": " << s.ticks << ", \"seed\": " << s.seed
+              << ", \"wall_ms\": " << s.wall_ms << ", \"won\": " << (s.won ? "true" : "false") << "}\n";
 }
 
 void snz::SnakeSimulation::process_events()
 { // INCOMPLETO
 
+    if (opt.headless || replayer.is_open())
+        return;
+
     if (state == simulation_state_e::START ||
         state == simulation_state_e::CRASH ||
         state == simulation_state_e::LEVEL_UP)
+    {
         std::cin.get();
+        // The <ENTER> echo may have scrolled the screen, and the wait isn't a late tick.
+        renderer.invalidate();
+        scheduler.reset();
+    }
 }
 
 void snz::SnakeSimulation::update()
 {
+    {
+        double ignored_ms = 0;
+        PhaseTimer timer(state == simulation_state_e::THINKING ? stats.thinking_ms
+                         : state == simulation_state_e::RUN    ? stats.run_ms
+                                                               : ignored_ms);
+        advance();
+    }
+
+    if (recorder.is_open() || replayer.is_open())
+        check_replay();
+    if (!replay_msg.empty())
+        state = simulation_state_e::GAME_OVER;
+
+    // Planning starts as soon as the pellet is placed, and the frames go on meanwhile.
+    if (planner && state == simulation_state_e::THINKING && !planner->busy() && !cached_ready && needs_plan())
+    {
+        PlanState plan_from;
+        if (plan_state(plan_from) && use_cached_plan(plan_from))
+            cached_ready = true;
+        else
+            planner->request(snake, running_level->get_pellet_loc());
+    }
+
+    if (stats_out.is_open() && opt.stats_interval > 0 && ticks % opt.stats_interval == 0)
+        write_stats(false);
+}
+
+void snz::SnakeSimulation::advance()
+{
+    if (ticks++ == 0)
+        start_time = std::chrono::steady_clock::now();
+
+    if (opt.max_ticks > 0 && ticks > opt.max_ticks)
+    {
+        state = simulation_state_e::GAME_OVER;
+        return;
+    }
 
     if (state == simulation_state_e::START)
     {
         init_running_level();
+        life_start = ticks;
         state = simulation_state_e::THINKING;
     }
     else if (state == simulation_state_e::LEVEL_UP)
@@ -377,37 +909,68 @@ void snz::SnakeSimulation::update()
             running_level->set_tile_type(tile_pos, tile_type_e::EMPTY);
 
         snake.init();
+        life_start = ticks;
 
         state = simulation_state_e::THINKING; 
     }
     else if (state == simulation_state_e::RUN)
     {
-        MoveDir new_dir = player.next_move_random();
-        if(opt.player_type == "backtracking") {
-            if(!player.get_solution().empty()) new_dir = player.next_move(); 
-        } 
+        MoveDir new_dir;
+        if (replayer.is_open())
+        {
+            if (!replayer.next_move(new_dir))
+            {
+                if (replayer.at_end())
+                    replay_msg = ">>> The replay log ends at tick " + std::to_string(ticks) + ", before the game did.\n";
+                else
+                    replay_mismatch("no move in the log");
+                return;
+            }
+        }
+        else
+        {
+            new_dir = player.next_move_random();
+            if(opt.player_type == "cycle" && player.has_cycle())
+                new_dir = player.next_move_cycle();
+            else if(opt.player_type != "random") {
+                if(player.has_next_move()) new_dir = player.next_move(); 
+            } 
+        }
+
+        if (recorder.is_open() && !recorder.move(new_dir))
+        {
+            replay_msg = ">>> ERROR! The move of tick " + std::to_string(ticks) + " can't be recorded.\n";
+            replay_error = true;
+            return;
+        }
      
         snake.set_dir(new_dir);
 
         if (running_level->is_food(snake.get_next_location(new_dir)))
         {
             ++consumed_pellets;
-            score += 10 + snake.get_body().size()*5;
+            ++total_pellets;
+            score += 10 + snake.size()*5;
             
             if (consumed_pellets == opt.n_food_pellets_per_nivel)
             {
                 snake.step_foward(new_dir);
-                if(running_level == levels.end() - 1) 
+                if(running_level == levels.end() - 1) {
+                    won = true;
                     state = simulation_state_e::GAME_OVER;
+                }
                 else
                     state = simulation_state_e::LEVEL_UP;
                 return;
             }
-            running_level->place_pellet();
+            place_pellet();
             state = simulation_state_e::THINKING;
 
-        } else if (snake.get_next_location(new_dir) != snake.get_body().back() && running_level->crashed(snake.get_next_location(new_dir))) {
+        } else if (snake.get_next_location(new_dir) != snake.get_tail() && running_level->crashed(snake.get_next_location(new_dir))) {
             snake.set_lives(snake.get_lives() - 1);
+            ++crashes;
+            stats.ticks_per_life.push_back(ticks - life_start);
+            life_start = 0; // no life is running until the respawn
             if (snake.get_lives() == 0) state = simulation_state_e::GAME_OVER;
             else state = simulation_state_e::CRASH;
             return;
@@ -416,22 +979,50 @@ void snz::SnakeSimulation::update()
 
         snake.step_foward(new_dir);
     } else if(state == simulation_state_e::THINKING) {
-        if(opt.player_type == "backtracking")
-            player.find_solution();
+        if (planner && needs_plan())
+        {
+            if (cached_ready)
+                cached_ready = false;
+            else
+            {
+                if (!planner->poll())
+                    return; // still searching
+                player.set_solution(planner->get_player().get_solution());
+                record_search(planner->get_player());
+
+                // The snake and the pellet haven't moved since the request.
+                PlanState plan_from;
+                if (plan_state(plan_from))
+                    plan_cache.insert(plan_from, player.get_solution());
+            }
+        }
+        else if (!replayer.is_open())
+            plan();
         state = simulation_state_e::RUN;
     }
 }
 
 void snz::SnakeSimulation::render()
 {
+    PhaseTimer timer(stats.render_ms);
 
-    if(state == simulation_state_e::THINKING) 
+    if(state == simulation_state_e::THINKING && !planner) 
         return ;
 
-    std::chrono::milliseconds duration{1000 / opt.fps};
-    std::this_thread::sleep_for(duration);
+    if (opt.headless)
+    {
+        if (state == simulation_state_e::GAME_OVER)
+        {
+            print_summary();
+            std::cerr << replay_msg;
+        }
+        return;
+    }
+
+    if (state == simulation_state_e::RUN && ticks % render_every != 0)
+        return;
 
-    std::system("clear");
+    renderer.begin_frame(running_level->get_rows(), running_level->get_cols());
 
     if (state == simulation_state_e::START)
         print_welcome();
@@ -440,15 +1031,135 @@ void snz::SnakeSimulation::render()
     else if (state == simulation_state_e::CRASH) {
         print_crashed();
     } else if (state == simulation_state_e::GAME_OVER) {
-        if(snake.get_lives() == 0) print_lost();
-        else print_won();
+        if(won) print_won();
+        else print_lost();
+        print_timing();
+        renderer.add_text(replay_msg);
        // return ;
     }
 
     render_board();
+    renderer.present();
+}
+
+void snz::SnakeSimulation::invalidate_frame()
+{
+    renderer.invalidate();
 }
 
 bool snz::SnakeSimulation::game_over()
 {
     return (state == simulation_state_e::GAME_OVER);
-}
\ No newline at end of file
+}
+
+snz::SimulationSummary snz::SnakeSimulation::summary()
+{
+    double wall_ms = 0;
+    if (ticks > 0)
+        wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+    return {score, total_pellets, snake.get_lives(), crashes, ticks, opt.seed, wall_ms, won};
+}
+const snz::SimulationStats &snz::SnakeSimulation::get_stats() const
+{
+    return stats;
+}
+
+void snz::SnakeSimulation::write_stats(bool final)
+{
+    // The life that is still going counts at exit.
+    std::vector<unsigned long> lives = stats.ticks_per_life;
+    if (final && life_start > 0)
+        lives.push_back(ticks - life_start);
+
+    stats_out << "{\"ticks\": " << ticks << ", \"final\": " << (final ? "true" : "false")
+              << ", \"planner_calls\": " << stats.planner_calls << ", \"plan_cache_hits\": " << stats.plan_cache_hits
+              << ", \"plan_cache_misses\": " << stats.plan_cache_misses << ", \"nodes_expanded\": " << stats.nodes_expanded
+              << ", \"peak_frontier\": " << stats.peak_frontier << ", \"peak_visited\": " << stats.peak_visited
+              << ", \"thinking_ms\": " << stats.thinking_ms << ", \"run_ms\": " << stats.run_ms
+              << ", \"render_ms\": " << stats.render_ms << ", \"pellets_placed\": " << stats.pellets_placed
+              << ", \"pellet_ms\": " << stats.pellet_ms << ", \"crashes\": " << crashes << ", \"ticks_per_life\": [";
+    for (size_t i{0}; i < lives.size(); ++i)
+        stats_out << (i > 0 ? ", " : "") << lives[i];
+    stats_out << "]}" << std::endl;
+}
+
+snz::SnakeSimulation::~SnakeSimulation()
+{
+    if (stats_out.is_open())
+        write_stats(true);
+
+    if (recorder.is_open() && !recorder.close())
+        std::cerr << ">>> ERROR! Unable to write the replay log.\n";
+
+    if (save_plan_cache && !plan_cache.save(opt.plan_cache_file))
+        std::cerr << ">>> ERROR! Unable to write plan cache file.\n";
+}
+
+uint64_t snz::SnakeSimulation::state_checksum()
+{
+    uint32_t score_bits;
+    std::memcpy(&score_bits, &score, sizeof(score_bits));
+
+    StateHash hash;
+    hash.add(ticks);
+    hash.add(state);
+    hash.add(running_level - levels.begin());
+    hash.add(snake.get_lives());
+    hash.add(score_bits);
+    hash.add(consumed_pellets);
+    hash.add(total_pellets);
+    hash.add(running_level->get_pellet_loc().row);
+    hash.add(running_level->get_pellet_loc().col);
+    hash.add(static_cast<uint16_t>(snake.get_dir().dx));
+    hash.add(static_cast<uint16_t>(snake.get_dir().dy));
+    for (const auto &tile_pos : snake.get_body())
+        hash.add(running_level->cell_index(tile_pos));
+    return hash.value();
+}
+
+void snz::SnakeSimulation::check_replay()
+{
+    bool end = state == simulation_state_e::GAME_OVER;
+    if (!replay_msg.empty() || (!end && ticks % checksum_interval != 0))
+        return;
+
+    uint64_t sum = state_checksum();
+    if (recorder.is_open())
+    {
+        recorder.checksum(ticks, sum, end);
+        if (end && !recorder.close())
+        {
+            replay_msg = ">>> ERROR! Unable to write the replay log.\n";
+            replay_error = true;
+        }
+        return;
+    }
+
+    uint64_t tick, recorded;
+    bool recorded_end;
+    if (!replayer.next_checksum(tick, recorded, recorded_end))
+    {
+        if (replayer.at_end())
+            replay_msg = ">>> The replay log ends at tick " + std::to_string(ticks) + ", before the game did.\n";
+        else
+            replay_mismatch("no checksum in the log");
+    }
+    else if (tick != ticks || recorded != sum)
+        replay_mismatch("the state checksum differs");
+    else if (recorded_end != end)
+        replay_mismatch(end ? "the game ended early" : "the game should have ended");
+    else if (end)
+        replay_msg = ">>> The replay matched the recorded game for " + std::to_string(ticks) + " ticks.\n";
+}
+
+void snz::SnakeSimulation::replay_mismatch(const std::string &reason)
+{
+    replay_msg = ">>> ERROR! The replay diverged at tick " + std::to_string(ticks) + ": " + reason + ".\n";
+    replay_error = true;
+}
+
+bool snz::SnakeSimulation::replay_failed() const
+{
+    return replay_error;
+}
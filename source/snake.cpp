@@ -1,5 +1,9 @@
 #include "../include/snake.h"
 
+#include <algorithm>
+
+const size_t Snake::MIN_RING;
+
 void Snake::set_lives(const unsigned short int l)
 {
     lives = l;
@@ -10,7 +14,7 @@ unsigned short int Snake::get_lives()
     return lives;
 }
 
-MoveDir Snake::get_dir()
+MoveDir Snake::get_dir() const
 {
     return dir;
 }
@@ -20,9 +24,29 @@ void Snake::set_dir(MoveDir d)
     dir = d;
 }
 
-std::deque<TilePos> Snake::get_body()
+BodyView Snake::get_body() const
+{
+    return BodyView(ring.data(), ring.size(), head, length);
+}
+
+TilePos Snake::get_head() const
+{
+    return ring[head];
+}
+
+TilePos Snake::get_tail() const
+{
+    return get_body().back();
+}
+
+size_t Snake::size() const
+{
+    return length;
+}
+
+uint64_t Snake::get_body_key() const
 {
-    return body;
+    return body_key;
 }
 
 void Snake::bind_level(Level *l)
@@ -32,16 +56,44 @@ void Snake::bind_level(Level *l)
 
 void Snake::init()
 {
-    body.clear();
-    body.push_back(running_level->get_spawn());
-    running_level->set_tile_type(body.front(), tile_type_e::SNAKEHEAD);
+    if (ring.empty())
+        ring.assign(MIN_RING, TilePos{0, 0});
+
+    head = 0;
+    length = 1;
+    ring[head] = running_level->get_spawn();
+    running_level->set_tile_type(ring[head], tile_type_e::SNAKEHEAD);
+    body_key = zobrist_key(ring[head]);
     dir.dx = 0;
     dir.dy = 0;
 }
 
+void Snake::set_body(const std::vector<TilePos> &body, const MoveDir d)
+{
+    for (const auto &tile_pos : get_body())
+        running_level->set_tile_type(tile_pos, tile_type_e::EMPTY);
+
+    size_t capacity = std::max(ring.size(), MIN_RING);
+    while (capacity < body.size())
+        capacity *= 2;
+    if (ring.size() < capacity)
+        ring.resize(capacity);
+
+    head = 0;
+    length = body.size();
+    body_key = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        ring[i] = body[i];
+        running_level->set_tile_type(body[i], i == 0 ? tile_type_e::SNAKEHEAD : tile_type_e::SNAKEBODY);
+        body_key ^= zobrist_key(body[i]);
+    }
+    dir = d;
+}
+
 TilePos Snake::get_next_location(MoveDir d)
 {
-    TilePos s_head = body.front();
+    TilePos s_head = ring[head];
     TilePos s_next;
 
     s_next.row = s_head.row + d.dy;
@@ -50,21 +102,41 @@ TilePos Snake::get_next_location(MoveDir d)
     return s_next;
 }
 
+void Snake::grow_ring()
+{
+    std::vector<TilePos> bigger(2 * ring.size());
+
+    BodyView body = get_body();
+    for (size_t i = 0; i < length; ++i)
+        bigger[i] = body[i];
+
+    ring.swap(bigger);
+    head = 0;
+}
+
 void Snake::step_foward(MoveDir d)
 {
 
     TilePos s_next = get_next_location(d);
+    bool grows = running_level->is_food(s_next);
 
-    if (!body.empty())
-        running_level->set_tile_type(body.front(), tile_type_e::SNAKEBODY);
+    if (length > 0)
+        running_level->set_tile_type(ring[head], tile_type_e::SNAKEBODY);
 
-    body.push_front(s_next);
-
-    if (!running_level->is_food(s_next))
+    // The tail leaves before the head arrives, so only a growing snake can fill the ring.
+    if (!grows)
     {
-        running_level->set_tile_type(body.back(), tile_type_e::EMPTY);
-        body.pop_back();
+        running_level->set_tile_type(get_tail(), tile_type_e::EMPTY);
+        body_key ^= zobrist_key(get_tail());
+        --length;
     }
+    else if (length == ring.size())
+        grow_ring();
+
+    head = (head == 0 ? ring.size() : head) - 1;
+    ring[head] = s_next;
+    ++length;
+    body_key ^= zobrist_key(s_next);
 
     running_level->set_tile_type(s_next, tile_type_e::SNAKEHEAD);
-}
\ No newline at end of file
+}
@@ -0,0 +1,342 @@
+/**!
+ *  This program runs many headless Snaze simulations in parallel.
+ *
+ *  Every combination of level file, player type and number of food pellets is
+ *  played with a range of seeds on a pool of worker threads, and the results
+ *  are aggregated into one JSON line of statistics per combination.
+ *
+ *  To compile: use cmake script.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib> // EXIT_SUCCESS
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../include/simulation.h"
+
+namespace
+{
+    /**
+     * @brief Struct that represents the tournament options.
+     */
+    struct TournamentOptions
+    {
+        int runs = 10;                                                         //<! Games played per configuration.
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency()); //<! Number of worker threads.
+        unsigned long max_ticks = 100000;                                      //<! Tick limit of each game.
+        unsigned long seed = 1;                                                //<! Seed of the first game of each configuration.
+        std::vector<std::string> players = {"backtracking", "astar", "random"};  //<! Player types to be played.
+        std::vector<int> foods = {10};                                         //<! Food values to be played.
+        std::vector<std::string> files;                                        //<! Level files to be played.
+    };
+
+    /**
+     * @brief Struct that represents one game of the tournament.
+     */
+    struct Run
+    {
+        size_t config;                 //<! Index of the configuration the game belongs to.
+        int replica;                   //<! Index of the game inside its configuration.
+        bool ok = false;               //<! False if the simulation failed to initialize.
+        std::string error;             //<! The error message, if any.
+        snz::SimulationSummary result; //<! The outcome of the game.
+    };
+
+    /**
+     * @brief Struct that represents a configuration: a level file, a player type and a food value.
+     */
+    struct Config
+    {
+        std::string file;   //<! The level file.
+        std::string player; //<! The player type.
+        int food;           //<! The number of food pellets per level.
+    };
+
+    std::string usage()
+    {
+        std::ostringstream oss;
+        oss << "Usage: snaze_tournament [<options>] <input_level_file> [<input_level_file> ...]\n"
+            << "   Tournament options:\n"
+            << "       --help                  Print this help text.\n"
+            << "       --runs <num>            Games played per configuration, with seeds seed, seed + 1, ... Default = 10.\n"
+            << "       --seed <num>            Seed of the first game of each configuration. Default = 1.\n"
+            << "       --players <list>        Comma separated player types. Default = backtracking,astar,random.\n"
+            << "       --food <list>           Comma separated food values, each in [1, 20]. Default = 10.\n"
+            << "       --threads <num>         Number of worker threads. Default = number of cores.\n"
+            << "       --max-ticks <num>       Tick limit of each game. Default = 100000.\n";
+        return oss.str();
+    }
+
+    std::vector<std::string> split(const std::string &s)
+    {
+        std::vector<std::string> parts;
+        std::istringstream ss(s);
+        std::string part;
+        while (std::getline(ss, part, ','))
+            if (!part.empty())
+                parts.push_back(part);
+        return parts;
+    }
+
+    /**
+     * @brief Parse a whole command line value as a number in [min, max].
+     * @throw std::invalid_argument if the value isn't a number in the range.
+     */
+    unsigned long parse_number(const std::string &s, unsigned long min, unsigned long max)
+    {
+        // std::stoul would take a sign, and wrap a negative value around.
+        if (s.empty() || !std::isdigit(static_cast<unsigned char>(s[0])))
+            throw std::invalid_argument(s);
+
+        size_t end;
+        unsigned long value = std::stoul(s, &end);
+        if (end != s.size() || value < min || value > max)
+            throw std::invalid_argument(s);
+        return value;
+    }
+
+    /**
+     * @brief Quote a string for the JSON output, escaping what JSON doesn't allow in it.
+     */
+    std::string json_string(const std::string &s)
+    {
+        std::string out = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+                out += code;
+            }
+            else
+                out += c;
+        }
+        return out + "\"";
+    }
+
+    /**
+     * @brief Play one headless game to the end.
+     * @param cfg The configuration of the game.
+     * @param max_ticks The tick limit of the game.
+     * @param seed The seed of the game.
+     * @param run Where the outcome is stored.
+     */
+    void play(const Config &cfg, unsigned long max_ticks, unsigned long seed, Run &run)
+    {
+        std::vector<std::string> args = {"snaze_tournament", "--headless",
+                                         "--seed", std::to_string(seed),
+                                         "--playertype", cfg.player,
+                                         "--food", std::to_string(cfg.food),
+                                         "--max-ticks", std::to_string(max_ticks),
+                                         "--parallel-threshold", "0", // the games already fill the cores
+                                         cfg.file};
+        std::vector<char *> argv;
+        for (auto &a : args)
+            argv.push_back(&a[0]);
+
+        snz::SnakeSimulation simulation;
+        auto result = simulation.initialize(argv.size(), argv.data());
+        if (result.type == snz::simulation_result_e::ERROR)
+        {
+            run.error = result.msg;
+            return;
+        }
+
+        while (not simulation.game_over())
+            simulation.update();
+
+        run.result = simulation.summary();
+        run.ok = true;
+    }
+
+    /**
+     * @brief Get the value at a given percentile of a sorted vector.
+     */
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        size_t idx = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[idx];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    TournamentOptions opt;
+
+    for (int i{1}; i < argc; ++i)
+    {
+        std::string str = argv[i];
+        bool has_value = i + 1 < argc;
+        std::string valid; // what the option takes, for the error message
+
+        try
+        {
+            if (str == "--help" || str == "--h")
+            {
+                std::cout << usage();
+                return EXIT_SUCCESS;
+            }
+            else if (str == "--runs" && has_value)
+            {
+                valid = "a number of games of at least 1";
+                opt.runs = parse_number(argv[++i], 1, std::numeric_limits<int>::max());
+            }
+            else if (str == "--seed" && has_value)
+            {
+                valid = "a number of at least 0";
+                opt.seed = parse_number(argv[++i], 0, std::numeric_limits<unsigned long>::max());
+            }
+            else if (str == "--threads" && has_value)
+            {
+                valid = "a number of threads of at least 1";
+                opt.threads = parse_number(argv[++i], 1, std::numeric_limits<unsigned>::max());
+            }
+            else if (str == "--max-ticks" && has_value)
+            {
+                valid = "a number of at least 0";
+                opt.max_ticks = parse_number(argv[++i], 0, std::numeric_limits<unsigned long>::max());
+            }
+            else if (str == "--players" && has_value)
+                opt.players = split(argv[++i]);
+            else if (str == "--food" && has_value)
+            {
+                // The same range as snaze's --food.
+                valid = "numbers in [1, 20], separated by commas";
+                opt.foods.clear();
+                for (auto &food : split(argv[++i]))
+                    opt.foods.push_back(parse_number(food, 1, 20));
+                if (opt.foods.empty())
+                    throw std::invalid_argument(argv[i]);
+            }
+            else if (str.compare(0, 2, "--") == 0)
+            {
+                std::cerr << usage() << ">>> ERROR! Invalid option " << str << ".\n";
+                return EXIT_FAILURE;
+            }
+            else
+                opt.files.push_back(str);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << ">>> ERROR! Invalid value for " << str << ". Use " << valid << ".\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (opt.files.empty())
+    {
+        std::cerr << usage() << ">>> ERROR! No level file provided.\n";
+        return EXIT_FAILURE;
+    }
+
+    // The cross product of files, players and foods, each played opt.runs times.
+    std::vector<Config> configs;
+    for (auto &f : opt.files)
+        for (auto &p : opt.players)
+            for (auto &food : opt.foods)
+                configs.push_back({f, p, food});
+
+    std::vector<Run> runs;
+    for (size_t c{0}; c < configs.size(); ++c)
+        for (int r{0}; r < opt.runs; ++r)
+        {
+            Run run;
+            run.config = c;
+            run.replica = r;
+            runs.push_back(run);
+        }
+
+    // Workers grab the next game from a shared counter until none is left.
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < runs.size(); i = next++)
+            play(configs[runs[i].config], opt.max_ticks, opt.seed + runs[i].replica, runs[i]);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    unsigned n_threads = std::min<size_t>(opt.threads, runs.size());
+    for (unsigned t{0}; t < n_threads; ++t)
+        pool.emplace_back(worker);
+    for (auto &t : pool)
+        t.join();
+
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    unsigned long all_ticks = 0;
+    for (size_t c{0}; c < configs.size(); ++c)
+    {
+        std::vector<double> scores;
+        unsigned long ticks = 0;
+        double wall_ms = 0;
+        int crashes = 0, crashed_games = 0, wins = 0, failed = 0;
+        std::string error;
+
+        for (auto &run : runs)
+        {
+            if (run.config != c)
+                continue;
+            if (!run.ok)
+            {
+                ++failed;
+                error = run.error;
+                continue;
+            }
+            scores.push_back(run.result.score);
+            ticks += run.result.ticks;
+            wall_ms += run.result.wall_ms;
+            crashes += run.result.crashes;
+            crashed_games += run.result.crashes > 0;
+            wins += run.result.won;
+        }
+        all_ticks += ticks;
+
+        std::cout << "{\"file\": " << json_string(configs[c].file) << ", \"player\": " << json_string(configs[c].player)
+                  << ", \"food\": " << configs[c].food << ", \"games\": " << scores.size();
+
+        if (failed > 0)
+        {
+            std::cout << ", \"failed\": " << failed << "}\n";
+            std::cerr << configs[c].file << ": " << error;
+            continue;
+        }
+
+        std::sort(scores.begin(), scores.end());
+        double mean = 0;
+        for (double s : scores)
+            mean += s;
+        mean /= scores.size();
+
+        std::cout << ", \"score_mean\": " << mean
+                  << ", \"score_p10\": " << percentile(scores, 0.10)
+                  << ", \"score_p50\": " << percentile(scores, 0.50)
+                  << ", \"score_p90\": " << percentile(scores, 0.90)
+                  << ", \"crash_rate\": " << static_cast<double>(crashed_games) / scores.size()
+                  << ", \"crashes_per_game\": " << static_cast<double>(crashes) / scores.size()
+                  << ", \"win_rate\": " << static_cast<double>(wins) / scores.size()
+                  << ", \"ticks_per_sec\": " << (wall_ms > 0 ? ticks / (wall_ms / 1000) : 0) << "}\n";
+    }
+
+    std::cout << "{\"games\": " << runs.size() << ", \"threads\": " << n_threads
+              << ", \"wall_sec\": " << elapsed
+              << ", \"ticks_per_sec\": " << (elapsed > 0 ? all_ticks / elapsed : 0) << "}\n";
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+#include "../include/visited_table.h"
+
+void VisitedTable::reset(const size_t n_keys) {
+    for (uint32_t w : touched)
+        words[w] = 0;
+    touched.clear();
+    count = 0;
+
+    size_t n_words = (n_keys + 63) / 64;
+    if (words.size() < n_words)
+        words.resize(n_words, 0);
+}
+
+void ConcurrentVisitedTable::reset(const size_t n_keys, const unsigned n_threads) {
+    for (auto &list : touched) {
+        for (uint32_t w : list)
+            words[w].store(0, std::memory_order_relaxed);
+        list.clear();
+    }
+    touched.resize(n_threads);
+    counts.assign(n_threads, 0);
+
+    size_t needed = (n_keys + 63) / 64;
+    if (n_words < needed) {
+        words.reset(new std::atomic<uint64_t>[needed]);
+        for (size_t w = 0; w < needed; ++w)
+            words[w].store(0, std::memory_order_relaxed);
+        n_words = needed;
+    }
+}
+
+size_t ConcurrentVisitedTable::size() const {
+    size_t total = 0;
+    for (size_t c : counts)
+        total += c;
+    return total;
+}
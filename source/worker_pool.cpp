@@ -0,0 +1,62 @@
+#include "../include/worker_pool.h"
+
+WorkerPool::WorkerPool(unsigned n) {
+    for (unsigned id = 1; id < n; ++id)
+        threads.emplace_back(&WorkerPool::work, this, id);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &t : threads)
+        t.join();
+}
+
+unsigned WorkerPool::size() const {
+    return threads.size() + 1;
+}
+
+void WorkerPool::work(unsigned id) {
+    unsigned long seen = 0;
+
+    while (true) {
+        const std::function<void(unsigned)> *f;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            f = job;
+        }
+
+        (*f)(id);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--pending == 0)
+            done.notify_one();
+    }
+}
+
+void WorkerPool::run(const std::function<void(unsigned)> &f) {
+    if (threads.empty()) {
+        f(0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &f;
+        pending = threads.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    f(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return pending == 0; });
+}